@@ -9,6 +9,7 @@
 #include "ldebug.c"
 #include "ldo.c"
 #include "ldump.c"
+#include "lfastcall.c"
 #include "lfunc.c"
 #include "lgc.c"
 #include "llex.c"
@@ -0,0 +1,132 @@
+/*
+* tablebench.c -- microbenchmark for the hash part of tables
+* times hits and misses of luaH_getstr/luaH_getnum, luaH_set on existing
+* keys and inserts into new tables, for tables of growing size.
+* build like all.c: cc -O2 -I../src tablebench.c -lm -ldl
+*/
+
+#define luaall_c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lapi.c"
+#include "lcode.c"
+#include "ldebug.c"
+#include "ldo.c"
+#include "ldump.c"
+#include "lfunc.c"
+#include "lgc.c"
+#include "llex.c"
+#include "lmem.c"
+#include "lobject.c"
+#include "lopcodes.c"
+#include "lparser.c"
+#include "lstate.c"
+#include "lstring.c"
+#include "ltable.c"
+#include "ltm.c"
+#include "lundump.c"
+#include "lvm.c"
+#include "lzio.c"
+#include "lcoco.c"
+
+#include "lauxlib.c"
+
+#define NKEYS	(1<<20)
+#define NBEST	7	/* each figure is the best of NBEST runs */
+
+static TString *hit[NKEYS], *miss[NKEYS];
+static volatile int sink;
+
+static double now (void) {
+  return (double)clock() * 1e9 / CLOCKS_PER_SEC;
+}
+
+#define timeit(res, n, body) { \
+  int b_; res = 1e30; \
+  for (b_ = 0; b_ < NBEST; b_++) { \
+    double t0_ = now(), d_; \
+    body; \
+    d_ = now() - t0_; \
+    if (d_ < res) res = d_; \
+  } \
+  res /= (n); }
+
+static void bench (lua_State *L, int n) {
+  int reps = 4000000 / n + 1;
+  double sh, sm, nh, nm, set, ins;
+  int i, r, b;
+  Table *t = luaH_new(L, 0, 0);
+  Table *tn = luaH_new(L, 0, 0);
+  sethvalue(L, L->top, t); api_incr_top(L);
+  sethvalue(L, L->top, tn); api_incr_top(L);
+  for (i = 0; i < n; i++) {
+    TValue k;
+    setsvalue(L, &k, hit[i]);
+    setnvalue(luaH_set(L, t, &k), i);
+    setnvalue(luaH_setnum(L, tn, -i - 1), i);  /* keys go to the hash part */
+  }
+  timeit(sh, (double)reps*n, for (r = 0; r < reps; r++)
+    for (i = 0; i < n; i++) sink += ttisnil(luaH_getstr(t, hit[i])));
+  timeit(sm, (double)reps*n, for (r = 0; r < reps; r++)
+    for (i = 0; i < n; i++) sink += ttisnil(luaH_getstr(t, miss[i])));
+  timeit(nh, (double)reps*n, for (r = 0; r < reps; r++)
+    for (i = 0; i < n; i++) sink += ttisnil(luaH_getnum(tn, -i - 1)));
+  timeit(nm, (double)reps*n, for (r = 0; r < reps; r++)
+    for (i = 0; i < n; i++) sink += ttisnil(luaH_getnum(tn, -i - 1 - NKEYS)));
+  timeit(set, (double)reps*n, for (r = 0; r < reps; r++)
+    for (i = 0; i < n; i++) {
+      TValue k;
+      setsvalue(L, &k, hit[i]);
+      setnvalue(luaH_set(L, t, &k), r);
+    });
+  reps = reps/4 + 1;
+  ins = 1e30;
+  for (b = 0; b < NBEST; b++) {  /* new tables are freed outside the timing */
+    double t0 = now(), d;
+    for (r = 0; r < reps; r++) {
+      Table *t2 = luaH_new(L, 0, 0);
+      for (i = 0; i < n; i++) {
+        TValue k;
+        setsvalue(L, &k, hit[i]);
+        setnvalue(luaH_set(L, t2, &k), i);
+      }
+    }
+    d = now() - t0;
+    if (d < ins) ins = d;
+    luaC_fullgc(L);
+  }
+  ins /= (double)reps*n;
+  L->top -= 2;
+  printf("%-8d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+         n, sh, sm, nh, nm, set, ins);
+}
+
+int main (void) {
+  static const int sizes[] = {4, 64, 1024, 20000, 262144, NKEYS};
+  lua_State *L = luaL_newstate();
+  char buf[32];
+  int i;
+  if (L == NULL) return 1;
+  lua_gc(L, LUA_GCSTOP, 0);
+  for (i = 0; i < NKEYS; i++) {
+    sprintf(buf, "key%d", i);
+    hit[i] = luaS_new(L, buf);
+    sprintf(buf, "other%d", i);
+    miss[i] = luaS_new(L, buf);
+  }
+  for (i = NKEYS - 1; i > 0; i--) {  /* look keys up in random order */
+    int j = rand() % (i + 1);
+    TString *x = hit[i]; hit[i] = hit[j]; hit[j] = x;
+    x = miss[i]; miss[i] = miss[j]; miss[j] = x;
+  }
+  printf("ns/op    %9s %9s %9s %9s %9s %9s\n", "str hit", "str miss",
+         "num hit", "num miss", "set hit", "insert");
+  for (i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++)
+    bench(L, sizes[i]);
+  lua_close(L);
+  return 0;
+}
@@ -24,6 +24,7 @@
 
 #include "llvm/LLVMContext.h"
 #include "llvm/DerivedTypes.h"
+#include "llvm/Intrinsics.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/Module.h"
 #include "llvm/PassManager.h"
@@ -41,6 +42,7 @@
 #include <string>
 #include <vector>
 #include <math.h>
+#include <string.h>
 
 #include "LLVMCompiler.h"
 #ifdef __cplusplus
@@ -50,12 +52,15 @@ extern "C" {
 #include "lobject.h"
 #include "lstate.h"
 #include "ldo.h"
+#include "lfunc.h"
 #include "lmem.h"
 #include "lcoco.h"
+#include "llvm_lmathlib.h"
 #ifdef __cplusplus
 }
 #endif
 #include "load_vm_ops.h"
+#include "llvm_lua_config.h"
 
 /*
  * Using lazing compilation requires large 512K c-stacks for each coroutine.
@@ -105,6 +110,10 @@ static llvm::cl::opt<bool> DebugOpCodes("g",
                    llvm::cl::desc("Allow debugging of Lua code."),
                    llvm::cl::init(false));
 
+static llvm::cl::opt<bool> NoHookChecks("no-hook-checks",
+                   llvm::cl::desc("Don't check for debug hooks at loop back-edges and calls."),
+                   llvm::cl::init(false));
+
 static llvm::cl::opt<bool> DisableOpt("O0",
                    llvm::cl::desc("Disable optimizations."),
                    llvm::cl::init(false));
@@ -162,6 +171,8 @@ llvm::Type *LLVMCompiler::get_var_type(val_t type, hint_t hints) {
 			return llvm::Type::getInt64Ty(getCtx());
 		}
 		return llvm::Type::getDoubleTy(getCtx());
+	case VAR_T_OP_VALUE_0_PTR:
+		return llvm::Type::getInt32Ty(getCtx())->getPointerTo();
 	default:
 		fprintf(stderr, "Error: missing var_type=%d\n", type);
 		exit(1);
@@ -257,6 +268,8 @@ LLVMCompiler::LLVMCompiler(int useJIT) {
 		vm_next_OP = llvm::Function::Create(func_type,
 			llvm::Function::ExternalLinkage, "vm_next_OP", M);
 	}
+	// define extern vm_check_hook
+	vm_check_hook = M->getFunction("vm_check_hook");
 	// define extern vm_print_OP
 	vm_print_OP = M->getFunction("vm_print_OP");
 	if(vm_print_OP == NULL) {
@@ -307,6 +320,13 @@ LLVMCompiler::LLVMCompiler(int useJIT) {
 	vm_set_number = M->getFunction("vm_set_number");
 	// define extern vm_set_long
 	vm_set_long = M->getFunction("vm_set_long");
+	// define extern vm_math_guard
+	vm_math_guard = M->getFunction("vm_math_guard");
+	// define extern vm_scalar_* functions
+	vm_scalar_set = M->getFunction("vm_scalar_set");
+	vm_scalar_get = M->getFunction("vm_scalar_get");
+	vm_scalar_newtable = M->getFunction("vm_scalar_newtable");
+	vm_scalar_setfield = M->getFunction("vm_scalar_setfield");
 
 
 	// create prototype for vm_* functions.
@@ -540,6 +560,737 @@ void LLVMCompiler::compileAll(lua_State *L, Proto *parent) {
 	}
 }
 
+/*
+ * Mark the registers captured as upvalues by the OP_CLOSURE ops from 'start' to 'end' - 1.
+ * A closure can change a captured register whenever Lua code runs.
+ */
+static void find_captured(Proto *p, int start, int end, bool *captured)
+{
+	Instruction *code = p->code;
+	int x, n;
+
+	for(x = 0; x < MAXSTACK; x++) captured[x] = false;
+	for(x = start; x < end; x++) {
+		if(GET_OPCODE(code[x]) == OP_CLOSURE) {
+			int nups = p->p[GETARG_Bx(code[x])]->nups;
+			for(n = 1; n <= nups; n++) {
+				if(GET_OPCODE(code[x + n]) == OP_MOVE) captured[GETARG_B(code[x + n])] = true;
+			}
+			x += nups;
+		} else if(GET_OPCODE(code[x]) == OP_SETLIST && GETARG_C(code[x]) == 0) {
+			x++;
+		}
+	}
+}
+
+/*
+ * Mark OP_GETTABLE/OP_SETTABLE ops in the body of a numeric for loop that use the
+ * loop variable as the key.  The marked ops get the loop index directly from the
+ * 'for_idx' variable and try the table's array part before calling luaV_gettable/settable.
+ */
+void LLVMCompiler::hint_for_idx_ops(Proto *p, int start, int end, int idx_reg,
+	hint_t hint, llvm::Value *idx_var)
+{
+	Instruction *code = p->code;
+	bool captured[MAXSTACK];
+	Instruction op_intr;
+	int opcode;
+	int x;
+
+	// the loop variable must not be changed inside the loop body, directly or by a
+	// closure that captures it.
+	find_captured(p, start, end, captured);
+	if(captured[idx_reg]) return;
+	for(x = start; x < end; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		if(opcode == OP_LOADNIL) {
+			if(GETARG_A(op_intr) <= idx_reg && idx_reg <= GETARG_B(op_intr)) return;
+		} else if(testAMode(opcode) && GETARG_A(op_intr) == idx_reg) {
+			return;
+		}
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+		}
+	}
+	for(x = start; x < end; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+			continue;
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+			continue;
+		}
+		// ops from an outer loop.
+		if(op_values[x] != NULL) continue;
+		if((opcode == OP_GETTABLE && GETARG_C(op_intr) == idx_reg) ||
+				(opcode == OP_SETTABLE && GETARG_B(op_intr) == idx_reg)) {
+			op_hints[x] |= HINT_FOR_IDX | hint;
+			op_values[x] = new OPValues(2);
+			op_values[x]->set(1, idx_var);
+		}
+	}
+}
+
+static const struct {
+	const char *name;
+	int id;
+	int nargs;
+} math_calls[] = {
+	{ "abs", LLVM_MATH_ABS, 1 },
+	{ "acos", LLVM_MATH_ACOS, 1 },
+	{ "asin", LLVM_MATH_ASIN, 1 },
+	{ "atan", LLVM_MATH_ATAN, 1 },
+	{ "atan2", LLVM_MATH_ATAN2, 2 },
+	{ "ceil", LLVM_MATH_CEIL, 1 },
+	{ "cos", LLVM_MATH_COS, 1 },
+	{ "cosh", LLVM_MATH_COSH, 1 },
+	{ "deg", LLVM_MATH_DEG, 1 },
+	{ "exp", LLVM_MATH_EXP, 1 },
+	{ "floor", LLVM_MATH_FLOOR, 1 },
+	{ "fmod", LLVM_MATH_FMOD, 2 },
+	{ "log", LLVM_MATH_LOG, 1 },
+	{ "log10", LLVM_MATH_LOG10, 1 },
+	{ "pow", LLVM_MATH_POW, 2 },
+	{ "rad", LLVM_MATH_RAD, 1 },
+	{ "sin", LLVM_MATH_SIN, 1 },
+	{ "sinh", LLVM_MATH_SINH, 1 },
+	{ "sqrt", LLVM_MATH_SQRT, 1 },
+	{ "tan", LLVM_MATH_TAN, 1 },
+	{ "tanh", LLVM_MATH_TANH, 1 },
+	{ NULL, 0, 0 },
+};
+
+/*
+ * Guess which math library function an OP_CALL calls from the name used to load
+ * the function value: the table key ('math.sqrt'), global, upvalue or local name.
+ * Only calls with one result are handled.  The guess is checked at runtime by vm_math_guard.
+ */
+int LLVMCompiler::find_math_call(Proto *p, int pc)
+{
+	Instruction op_intr = p->code[pc];
+	int ra = GETARG_A(op_intr);
+	int nargs = GETARG_B(op_intr) - 1;
+	const char *name = NULL;
+	TValue *kv = NULL;
+	int x;
+
+	if(GETARG_C(op_intr) != 2 || nargs < 1 || nargs > 2) return -1;
+	// find the op that loaded the function, the arguments only use registers above it.
+	for(x = pc - 1; x >= 0; x--) {
+		op_intr = p->code[x];
+		if(testAMode(GET_OPCODE(op_intr)) && GETARG_A(op_intr) <= ra) break;
+	}
+	if(x < 0 || GETARG_A(op_intr) != ra) return -1;
+	switch(GET_OPCODE(op_intr)) {
+	case OP_GETTABLE:
+		if(ISK(GETARG_C(op_intr))) kv = p->k + INDEXK(GETARG_C(op_intr));
+		break;
+	case OP_GETGLOBAL:
+		kv = p->k + GETARG_Bx(op_intr);
+		break;
+	case OP_GETUPVAL:
+		if(GETARG_B(op_intr) < p->sizeupvalues && p->upvalues[GETARG_B(op_intr)] != NULL) {
+			name = getstr(p->upvalues[GETARG_B(op_intr)]);
+		}
+		break;
+	case OP_MOVE:
+		name = luaF_getlocalname(p, GETARG_B(op_intr) + 1, x);
+		break;
+	default:
+		break;
+	}
+	if(kv != NULL && ttisstring(kv)) name = svalue(kv);
+	if(name == NULL) return -1;
+	for(x = 0; math_calls[x].name != NULL; x++) {
+		if(math_calls[x].nargs == nargs && strcmp(math_calls[x].name, name) == 0) {
+			return math_calls[x].id;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Emit math library function 'id'.  LLVM intrinsics are used where they have the same
+ * semantics as libm, the other functions are called as libm functions without side-effects
+ * which LLVM knows how to constant fold.
+ */
+llvm::Value *LLVMCompiler::emit_math_call(llvm::IRBuilder<> &Builder, int id,
+	llvm::Value *x, llvm::Value *y)
+{
+	llvm::Type *Ty_double = llvm::Type::getDoubleTy(getCtx());
+	const double radians_per_degree = 3.14159265358979323846/180.0;
+	llvm::Intrinsic::ID intrinsic = llvm::Intrinsic::not_intrinsic;
+	const char *libm_name = NULL;
+	llvm::Value *func;
+
+	switch(id) {
+	case LLVM_MATH_DEG:
+		return Builder.CreateFDiv(x, llvm::ConstantFP::get(Ty_double, radians_per_degree), "deg");
+	case LLVM_MATH_RAD:
+		return Builder.CreateFMul(x, llvm::ConstantFP::get(Ty_double, radians_per_degree), "rad");
+	case LLVM_MATH_COS: intrinsic = llvm::Intrinsic::cos; break;
+	case LLVM_MATH_EXP: intrinsic = llvm::Intrinsic::exp; break;
+	case LLVM_MATH_LOG: intrinsic = llvm::Intrinsic::log; break;
+	case LLVM_MATH_LOG10: intrinsic = llvm::Intrinsic::log10; break;
+	case LLVM_MATH_POW: intrinsic = llvm::Intrinsic::pow; break;
+	case LLVM_MATH_SIN: intrinsic = llvm::Intrinsic::sin; break;
+	// llvm.sqrt is undefined for negative numbers, the 'sqrt' libcall is still
+	// lowered to a sqrt instruction when it doesn't access memory.
+	case LLVM_MATH_SQRT: libm_name = "sqrt"; break;
+	case LLVM_MATH_ABS: libm_name = "fabs"; break;
+	case LLVM_MATH_ACOS: libm_name = "acos"; break;
+	case LLVM_MATH_ASIN: libm_name = "asin"; break;
+	case LLVM_MATH_ATAN: libm_name = "atan"; break;
+	case LLVM_MATH_ATAN2: libm_name = "atan2"; break;
+	case LLVM_MATH_CEIL: libm_name = "ceil"; break;
+	case LLVM_MATH_COSH: libm_name = "cosh"; break;
+	case LLVM_MATH_FLOOR: libm_name = "floor"; break;
+	case LLVM_MATH_FMOD: libm_name = "fmod"; break;
+	case LLVM_MATH_SINH: libm_name = "sinh"; break;
+	case LLVM_MATH_TAN: libm_name = "tan"; break;
+	case LLVM_MATH_TANH: libm_name = "tanh"; break;
+	default:
+		assert(false && "unknown math function");
+		return NULL;
+	}
+	if(intrinsic != llvm::Intrinsic::not_intrinsic) {
+		func = llvm::Intrinsic::getDeclaration(M, intrinsic, Ty_double);
+	} else {
+		std::vector<llvm::Type*> func_args(y != NULL ? 2 : 1, Ty_double);
+		func = M->getOrInsertFunction(libm_name,
+			llvm::FunctionType::get(Ty_double, func_args, false));
+		if(llvm::Function *libm_func = llvm::dyn_cast<llvm::Function>(func)) {
+			libm_func->setDoesNotAccessMemory();
+			libm_func->setDoesNotThrow();
+		}
+	}
+	if(y != NULL) {
+		return Builder.CreateCall2(func, x, y, "math");
+	}
+	return Builder.CreateCall(func, x, "math");
+}
+
+/*
+ * Ops where code compiled without '-g' checks for debug hooks: loop back-edges and calls.
+ */
+static bool is_hook_check_op(Instruction op_intr)
+{
+	switch(GET_OPCODE(op_intr)) {
+	case OP_JMP:
+		return GETARG_sBx(op_intr) < 0;
+	case OP_FORLOOP:
+	case OP_TFORLOOP:
+	case OP_CALL:
+	case OP_TAILCALL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#define REG_READ	1
+#define REG_WRITE	2
+#define REG_OPEN	(MAXSTACK + 1)
+
+/*
+ * How the op at 'pc' accesses register 'reg' (REG_READ/REG_WRITE).  Open ranges
+ * (B or C == 0 in CALL/RETURN/VARARG/SETLIST) cover all registers from A.
+ */
+static int op_reg_access(Proto *p, int pc, int reg)
+{
+	Instruction op_intr = p->code[pc];
+	int a = GETARG_A(op_intr);
+	int b = GETARG_B(op_intr);
+	int c = GETARG_C(op_intr);
+	int access = 0;
+	int x;
+
+#define in_range(first, last) ((first) <= reg && reg <= (last))
+#define reg_rk(rk) (!ISK(rk) && (rk) == reg)
+	switch(GET_OPCODE(op_intr)) {
+	case OP_MOVE:
+	case OP_UNM:
+	case OP_NOT:
+	case OP_LEN:
+	case OP_TESTSET:
+		if(b == reg) access |= REG_READ;
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_LOADK:
+	case OP_LOADBOOL:
+	case OP_GETUPVAL:
+	case OP_GETGLOBAL:
+	case OP_NEWTABLE:
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_LOADNIL:
+		if(in_range(a, b)) access |= REG_WRITE;
+		break;
+	case OP_GETTABLE:
+		if(b == reg || reg_rk(c)) access |= REG_READ;
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_SETGLOBAL:
+	case OP_SETUPVAL:
+	case OP_TEST:
+		if(a == reg) access |= REG_READ;
+		break;
+	case OP_SETTABLE:
+		if(a == reg || reg_rk(b) || reg_rk(c)) access |= REG_READ;
+		break;
+	case OP_SELF:
+		if(b == reg || reg_rk(c)) access |= REG_READ;
+		if(in_range(a, a + 1)) access |= REG_WRITE;
+		break;
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_MOD:
+	case OP_POW:
+		if(reg_rk(b) || reg_rk(c)) access |= REG_READ;
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_CONCAT:
+		if(in_range(b, c)) access |= REG_READ;
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_EQ:
+	case OP_LT:
+	case OP_LE:
+		if(reg_rk(b) || reg_rk(c)) access |= REG_READ;
+		break;
+	case OP_CALL:
+		if(in_range(a, b == 0 ? REG_OPEN : a + b - 1)) access |= REG_READ;
+		if(in_range(a, c == 0 ? REG_OPEN : a + c - 2)) access |= REG_WRITE;
+		break;
+	case OP_TAILCALL:
+		if(in_range(a, b == 0 ? REG_OPEN : a + b - 1)) access |= REG_READ;
+		break;
+	case OP_RETURN:
+		if(in_range(a, b == 0 ? REG_OPEN : a + b - 2)) access |= REG_READ;
+		break;
+	case OP_FORLOOP:
+	case OP_FORPREP:
+		if(in_range(a, a + 3)) access |= REG_READ | REG_WRITE;
+		break;
+	case OP_TFORLOOP:
+		if(in_range(a, a + 2)) access |= REG_READ;
+		if(in_range(a + 3, a + 2 + c)) access |= REG_WRITE;
+		break;
+	case OP_SETLIST:
+		if(in_range(a, b == 0 ? REG_OPEN : a + b)) access |= REG_READ;
+		break;
+	case OP_CLOSURE:
+		// upvalues are captured by the pseudo ops after OP_CLOSURE.
+		for(x = p->p[GETARG_Bx(op_intr)]->nups; x > 0; x--) {
+			Instruction pseudo_op = p->code[pc + x];
+			if(GET_OPCODE(pseudo_op) == OP_MOVE && GETARG_B(pseudo_op) == reg) access |= REG_READ;
+		}
+		if(a == reg) access |= REG_WRITE;
+		break;
+	case OP_VARARG:
+		if(in_range(a, b == 0 ? REG_OPEN : a + b - 2)) access |= REG_WRITE;
+		break;
+	case OP_JMP:
+	case OP_CLOSE:
+	default:
+		break;
+	}
+#undef in_range
+#undef reg_rk
+	return access;
+}
+
+/* keys computed in 64-bit integers must be exact as doubles. */
+#define MAX_EXACT_INT 9007199254740992.0 /* 2^53 */
+
+/*
+ * Mark OP_GETTABLE/OP_SETTABLE ops in the body of a numeric for loop with a lua_Long index
+ * that use a key computed from the loop variable with OP_ADD/OP_SUB/OP_MUL and whole number
+ * constants ('t[i*2+1]').  The marked ops compute the key as 'idx * mul + add' from the
+ * 'for_idx' variable in integers.  The loop's init/limit constants bound every key so the
+ * integer and double results are the same.  Keys are only tracked inside one basic block.
+ */
+void LLVMCompiler::hint_for_int_keys(Proto *p, int start, int end, int idx_reg, OPValues *loop_vals)
+{
+	Instruction *code = p->code;
+	bool derived[MAXSTACK];
+	bool captured[MAXSTACK];
+	double mul[MAXSTACK], add[MAXSTACK];
+	double idx_bound, lo, hi;
+	Instruction op_intr;
+	int opcode;
+	int x, r, key;
+
+	lo = (double)llvm::cast<llvm::ConstantInt>(loop_vals->get(0))->getSExtValue();
+	hi = (double)llvm::cast<llvm::ConstantInt>(loop_vals->get(1))->getSExtValue();
+	idx_bound = fabs(lo) > fabs(hi) ? fabs(lo) : fabs(hi);
+	// the loop variable must not be changed inside the loop body, directly or by a
+	// closure that captures it.
+	find_captured(p, start, end, captured);
+	if(captured[idx_reg]) return;
+	for(x = start; x < end; x++) {
+		if(op_reg_access(p, x, idx_reg) & REG_WRITE) return;
+		op_intr = code[x];
+		if(GET_OPCODE(op_intr) == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(GET_OPCODE(op_intr) == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+		}
+	}
+	// a key kept in a local that any closure of the function captures can change in a call.
+	find_captured(p, 0, p->sizecode, captured);
+	for(r = 0; r < MAXSTACK; r++) derived[r] = false;
+	for(x = start; x < end; x++) {
+		bool is_lin = false;
+		double m = 0, a = 0;
+
+		if(need_op_block[x]) {
+			for(r = 0; r < MAXSTACK; r++) derived[r] = false;
+		}
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		key = -1;
+		if(opcode == OP_GETTABLE) key = GETARG_C(op_intr);
+		else if(opcode == OP_SETTABLE) key = GETARG_B(op_intr);
+		if(key >= 0 && !ISK(key) && derived[key] && op_values[x] == NULL) {
+			op_hints[x] |= HINT_FOR_IDX | HINT_USE_LONG;
+			op_hints[x] &= ~(HINT_MINI_VM);
+			op_values[x] = new OPValues(4);
+			op_values[x]->set(1, loop_vals->get(3));
+			op_values[x]->set(2, llvm::ConstantInt::get(getCtx(), llvm::APInt(64, (lua_Long)mul[key], true)));
+			op_values[x]->set(3, llvm::ConstantInt::get(getCtx(), llvm::APInt(64, (lua_Long)add[key], true)));
+		}
+		if(opcode == OP_ADD || opcode == OP_SUB || opcode == OP_MUL) {
+			double om[2], oa[2];
+			int operands[2] = { GETARG_B(op_intr), GETARG_C(op_intr) };
+			int n;
+			// each operand as 'idx * om + oa'.
+			for(n = 0; n < 2; n++) {
+				int rk = operands[n];
+				if(ISK(rk)) {
+					TValue *kv = p->k + INDEXK(rk);
+					if(!ttisnumber(kv) || floor(nvalue(kv)) != nvalue(kv) ||
+							fabs(nvalue(kv)) >= MAX_EXACT_INT) break;
+					om[n] = 0; oa[n] = nvalue(kv);
+				} else if(rk == idx_reg) {
+					om[n] = 1; oa[n] = 0;
+				} else if(derived[rk]) {
+					om[n] = mul[rk]; oa[n] = add[rk];
+				} else {
+					break;
+				}
+			}
+			if(n == 2) {
+				is_lin = true;
+				if(opcode == OP_ADD) {
+					m = om[0] + om[1]; a = oa[0] + oa[1];
+				} else if(opcode == OP_SUB) {
+					m = om[0] - om[1]; a = oa[0] - oa[1];
+				} else if(om[0] == 0 || om[1] == 0) {
+					double c = (om[0] == 0) ? oa[0] : oa[1];
+					n = (om[0] == 0) ? 1 : 0;
+					m = om[n] * c; a = oa[n] * c;
+				} else {
+					is_lin = false; /* idx * idx */
+				}
+				if(fabs(m) * idx_bound + fabs(a) >= MAX_EXACT_INT) is_lin = false;
+			}
+		}
+		// forget registers changed by this op.
+		for(r = 0; r < MAXSTACK; r++) {
+			if(derived[r] && (op_reg_access(p, x, r) & REG_WRITE)) derived[r] = false;
+		}
+		if(is_lin && !captured[GETARG_A(op_intr)]) {
+			r = GETARG_A(op_intr);
+			derived[r] = true;
+			mul[r] = m;
+			add[r] = a;
+		}
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+		}
+	}
+}
+
+#define MAX_SCALAR_FIELDS 8
+
+/*
+ * Check if the table created by the OP_NEWTABLE at 'pc' escapes the function.  The
+ * table register must not be written by any other op and only be used as the table of
+ * OP_GETTABLE/OP_SETTABLE ops with constant keys after the OP_NEWTABLE.  Each key gets
+ * a TValue variable and an 'is_table' flag is set when the real table had to be created.
+ */
+void LLVMCompiler::hint_scalar_table(Proto *p, int pc, llvm::IRBuilder<> &Builder)
+{
+	Instruction *code = p->code;
+	int ra = GETARG_A(code[pc]);
+	int keys[MAX_SCALAR_FIELDS];
+	int nkeys = 0;
+	llvm::Value *fields[MAX_SCALAR_FIELDS];
+	llvm::Value *flag;
+	Instruction op_intr;
+	int opcode;
+	int access;
+	int key;
+	int x, n;
+
+	// parameters are set by the caller.
+	if(ra < p->numparams + ((p->is_vararg & VARARG_NEEDSARG) ? 1 : 0)) return;
+	for(x = 0; x < p->sizecode; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		access = (x == pc) ? 0 : op_reg_access(p, x, ra);
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups; /* skip pseudo ops. */
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++; /* skip count value. */
+		}
+		if(access == 0) continue;
+		if((access & REG_WRITE) || x < pc || op_values[x] != NULL) return;
+		if(opcode == OP_GETTABLE && GETARG_B(op_intr) == ra && ISK(GETARG_C(op_intr))) {
+			key = INDEXK(GETARG_C(op_intr));
+		} else if(opcode == OP_SETTABLE && GETARG_A(op_intr) == ra && ISK(GETARG_B(op_intr)) &&
+				GETARG_C(op_intr) != ra) {
+			key = INDEXK(GETARG_B(op_intr));
+		} else {
+			return; /* table escapes. */
+		}
+		if(!ttisstring(p->k + key) && !ttisnumber(p->k + key)) return;
+		for(n = 0; n < nkeys && keys[n] != key; n++);
+		if(n == nkeys) {
+			if(nkeys == MAX_SCALAR_FIELDS) return;
+			keys[nkeys++] = key;
+		}
+	}
+	// create variables in the entry block.
+	flag = Builder.CreateAlloca(llvm::Type::getInt32Ty(getCtx()), 0, "is_table");
+	Builder.CreateStore(llvm::ConstantInt::get(getCtx(), llvm::APInt(32,0)), flag);
+	for(n = 0; n < nkeys; n++) {
+		fields[n] = Builder.CreateAlloca(Ty_TValue, 0, "field");
+		Builder.CreateStore(llvm::Constant::getNullValue(Ty_TValue), fields[n]);
+	}
+	for(x = pc; x < p->sizecode; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		if(x == pc) {
+			key = -1;
+		} else if(opcode == OP_GETTABLE && GETARG_B(op_intr) == ra) {
+			key = INDEXK(GETARG_C(op_intr));
+		} else if(opcode == OP_SETTABLE && GETARG_A(op_intr) == ra) {
+			key = INDEXK(GETARG_B(op_intr));
+		} else {
+			if(opcode == OP_CLOSURE) {
+				x += p->p[GETARG_Bx(op_intr)]->nups;
+			} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+				x++;
+			}
+			continue;
+		}
+		op_hints[x] |= HINT_SCALAR_TABLE;
+		op_values[x] = new OPValues(2 + 2 * nkeys);
+		op_values[x]->set(0, flag);
+		for(n = 0; n < nkeys; n++) {
+			if(keys[n] == key) op_values[x]->set(1, fields[n]);
+			op_values[x]->set(2 + 2 * n, llvm::ConstantInt::get(getCtx(), llvm::APInt(32, keys[n])));
+			op_values[x]->set(3 + 2 * n, fields[n]);
+		}
+		if(x != pc) need_op_block[x + 1] = true; /* scalar path jumps over the table op. */
+	}
+}
+
+/* what is known about the value in a register. */
+#define VAL_UNKNOWN		0
+#define VAL_NUMBER		1
+#define VAL_NOT_GC		2 /* nil or boolean */
+
+/*
+ * Check if register 'reg' holds nil, a boolean or a number when the op at 'pc' runs.  Only
+ * the ops from the start of the basic block up to 'pc' are followed.  Ops that can run Lua
+ * code (calls, metamethods, GC finalizers) can change the registers captured as upvalues,
+ * so those are unknown after such an op.  A register can be an open upvalue at 'pc' if an
+ * OP_CLOSURE before 'pc' captures it, or one after 'pc' in a loop that jumps back to 'pc'.
+ */
+bool LLVMCompiler::reg_not_collectable(Proto *p, int pc, int reg)
+{
+	Instruction *code = p->code;
+	TValue *k = p->k;
+	char val[MAXSTACK];
+	bool captured[MAXSTACK];
+	Instruction op_intr;
+	int opcode, a, b, c;
+	int loop_end = -1;
+	int prev = -1;
+	int x, r;
+
+	for(r = 0; r < MAXSTACK; r++) val[r] = VAL_UNKNOWN;
+	for(x = 0; x < p->sizecode; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		if((opcode == OP_JMP || opcode == OP_FORLOOP) && GETARG_sBx(op_intr) < 0 &&
+				x + 1 + GETARG_sBx(op_intr) <= pc) {
+			loop_end = x;
+		} else if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+		}
+	}
+	find_captured(p, 0, pc > loop_end ? pc : loop_end, captured);
+#define rk_number(rk) (ISK(rk) ? ttisnumber(k + INDEXK(rk)) : val[rk] == VAL_NUMBER)
+	for(x = 0; x <= pc; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		a = GETARG_A(op_intr);
+		b = GETARG_B(op_intr);
+		c = GETARG_C(op_intr);
+		if(need_op_block[x]) {
+			for(r = 0; r < MAXSTACK; r++) val[r] = VAL_UNKNOWN;
+			// body of a numeric for loop, OP_FORLOOP sets the loop variable.
+			if(prev >= 0 && GET_OPCODE(code[prev]) == OP_FORPREP) {
+				int ra = GETARG_A(code[prev]);
+				int end = prev + 1 + GETARG_sBx(code[prev]);
+				for(r = x; r < end && !(op_reg_access(p, r, ra + 3) & REG_WRITE); r++) {
+					if(GET_OPCODE(code[r]) == OP_CLOSURE) {
+						r += p->p[GETARG_Bx(code[r])]->nups;
+					} else if(GET_OPCODE(code[r]) == OP_SETLIST && GETARG_C(code[r]) == 0) {
+						r++;
+					}
+				}
+				if(r >= end && !captured[ra + 3]) val[ra + 3] = VAL_NUMBER;
+			}
+		}
+		if(x == pc) break;
+		switch(opcode) {
+		case OP_MOVE:
+			val[a] = val[b];
+			break;
+		case OP_LOADK:
+			val[a] = ttisnumber(k + GETARG_Bx(op_intr)) ? VAL_NUMBER : VAL_UNKNOWN;
+			break;
+		case OP_LOADBOOL:
+		case OP_NOT:
+			val[a] = VAL_NOT_GC;
+			break;
+		case OP_LOADNIL:
+			for(r = a; r <= b; r++) val[r] = VAL_NOT_GC;
+			break;
+		case OP_GETUPVAL:
+			val[a] = VAL_UNKNOWN;
+			break;
+		case OP_SETUPVAL:
+		case OP_JMP:
+			break;
+		case OP_UNM:
+			if(val[b] == VAL_NUMBER) {
+				val[a] = VAL_NUMBER;
+				break;
+			}
+			goto may_run_code;
+		case OP_ADD:
+		case OP_SUB:
+		case OP_MUL:
+		case OP_DIV:
+		case OP_MOD:
+		case OP_POW:
+			if(rk_number(b) && rk_number(c)) {
+				val[a] = VAL_NUMBER;
+				break;
+			}
+			goto may_run_code;
+		default:
+		may_run_code:
+			for(r = 0; r < p->maxstacksize; r++) {
+				if(captured[r] || (op_reg_access(p, x, r) & REG_WRITE)) val[r] = VAL_UNKNOWN;
+			}
+			break;
+		}
+		prev = x;
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(opcode == OP_SETLIST && c == 0) {
+			x++;
+		}
+	}
+#undef rk_number
+	return val[reg] != VAL_UNKNOWN;
+}
+
+/* max. number of GC checks merged into one. */
+#define MAX_GC_MERGE 8
+
+/*
+ * Drop the write barrier of stores that never store a collectable value and merge the GC
+ * checks of the allocating ops (OP_NEWTABLE, OP_CONCAT, OP_CLOSURE) in a basic block into
+ * the check of the last one.  A skipped check only delays the next GC step.
+ */
+void LLVMCompiler::hint_gc_ops(Proto *p)
+{
+	Instruction *code = p->code;
+	TValue *k = p->k;
+	Instruction op_intr;
+	int last_gc = -1;
+	int merged = 0;
+	int opcode, c;
+	int x;
+
+	for(x = 0; x < p->sizecode; x++) {
+		op_intr = code[x];
+		opcode = GET_OPCODE(op_intr);
+		if(need_op_block[x]) last_gc = -1;
+		switch(opcode) {
+		case OP_NEWTABLE:
+			if(op_hints[x] & HINT_SCALAR_TABLE) break;
+			/* fall through */
+		case OP_CONCAT:
+		case OP_CLOSURE:
+			if(last_gc >= 0 && merged < MAX_GC_MERGE) {
+				op_hints[last_gc] |= HINT_NO_GC_CHECK;
+				merged++;
+			} else {
+				merged = 0;
+			}
+			last_gc = x;
+			break;
+		case OP_SETTABLE:
+			// only the for loop index ops have an inline barrier.
+			if(DebugOpCodes || (op_hints[x] & HINT_FOR_IDX) == 0) break;
+			c = GETARG_C(op_intr);
+			if(ISK(c) ? !ttisstring(k + INDEXK(c)) : reg_not_collectable(p, x, c)) {
+				op_hints[x] |= HINT_NO_BARRIER;
+			}
+			break;
+		case OP_SETUPVAL:
+			// line hooks can change any register with '-g'.
+			if(!DebugOpCodes && reg_not_collectable(p, x, GETARG_A(op_intr))) {
+				op_hints[x] |= HINT_NO_BARRIER;
+			}
+			break;
+		case OP_JMP:
+		case OP_RETURN:
+		case OP_TAILCALL:
+			// end of basic block.
+			last_gc = -1;
+			break;
+		default:
+			break;
+		}
+		if(opcode == OP_CLOSURE) {
+			x += p->p[GETARG_Bx(op_intr)]->nups;
+		} else if(opcode == OP_SETLIST && GETARG_C(op_intr) == 0) {
+			x++;
+		}
+	}
+}
+
 void LLVMCompiler::compile(lua_State *L, Proto *p)
 {
 	Instruction *code=p->code;
@@ -568,6 +1319,7 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 	Instruction op_intr;
 	int opcode;
 	int mini_op_repeat=0;
+	int newtable_site=0;
 	int i;
 	llvm::IRBuilder<> Builder(getCtx());
 
@@ -630,7 +1382,7 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 		op_intr=code[i];
 		opcode = GET_OPCODE(op_intr);
 		// combind simple ops into one function call.
-		if(is_mini_vm_op(opcode)) {
+		if(is_mini_vm_op(opcode) && (op_hints[i] & (HINT_FOR_IDX | HINT_SCALAR_TABLE)) == 0) {
 			mini_op_repeat++;
 		} else {
 			if(mini_op_repeat >= 3 && OptLevel > 1) {
@@ -652,6 +1404,18 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 				if(ttisnumber(rb)) op_hints[i] |= HINT_Bx_NUM_CONSTANT;
 				break;
 			}
+			case OP_GETTABLE:
+			case OP_SELF:
+				// field access with a string constant key, cache the key's node.
+				if(ISK(GETARG_C(op_intr)) && ttisstring(k + INDEXK(GETARG_C(op_intr)))) {
+					op_hints[i] |= HINT_STR_KEY;
+				}
+				break;
+			case OP_SETTABLE:
+				if(ISK(GETARG_B(op_intr)) && ttisstring(k + INDEXK(GETARG_B(op_intr)))) {
+					op_hints[i] |= HINT_STR_KEY;
+				}
+				break;
 			case OP_JMP:
 				// always branch to the offset stored in operand sBx
 				branch = i + 1 + GETARG_sBx(op_intr);
@@ -677,12 +1441,22 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 			case OP_TEST:
 			case OP_TESTSET:
 			case OP_TFORLOOP:
+				if(opcode == OP_TFORLOOP) {
+					// create tfor_pos, the iterator slot of the last key for inlined 'next' loops.
+					op_values[i] = new OPValues(1);
+					op_values[i]->set(0, Builder.CreateAlloca(llvm::Type::getInt32Ty(getCtx()), 0, "tfor_pos"));
+					Builder.CreateStore(llvm::ConstantInt::get(getCtx(), llvm::APInt(32,0)), op_values[i]->get(0));
+				}
 				branch = ++i + 1;
 				op_intr=code[i];
 				need_op_block[branch + GETARG_sBx(op_intr)] = true; /* inline JMP op. */
 				need_op_block[branch] = true;
 				break;
 			case OP_FORLOOP:
+				// integer keys computed from the loop variable, all branches in the body are known now.
+				if(OptLevel > 1 && (op_hints[i] & HINT_USE_LONG) && op_values[i] != NULL) {
+					hint_for_int_keys(p, i + 1 + GETARG_sBx(op_intr), i, GETARG_A(op_intr) + 3, op_values[i]);
+				}
 				branch = i+1;
 				need_op_block[branch] = true;
 				branch += GETARG_sBx(op_intr);
@@ -788,8 +1562,23 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 					}
 					// make sure OP_FORPREP doesn't subtract 'step' from 'init'
 					op_hints[i] |= HINT_NO_SUB;
+					// find table ops in the loop body that are indexed by the loop variable.
+					hint_for_idx_ops(p, i + 1, branch, forprep_ra + 3,
+						op_hints[branch] & HINT_USE_LONG, vals->get(3));
 				}
 				break;
+			case OP_NEWTABLE:
+				// keep the fields of tables that don't escape in local variables.
+				if(OptLevel > 1 && vm_scalar_set != NULL) {
+					hint_scalar_table(p, i, Builder);
+				}
+				// allocation site index, sites are numbered in pc order (see luaF_newtablesites).
+				if(op_values[i] == NULL) {
+					op_values[i] = new OPValues(1);
+					op_values[i]->set(0, llvm::ConstantInt::get(getCtx(), llvm::APInt(32, newtable_site)));
+				}
+				newtable_site++;
+				break;
 			case OP_SETLIST:
 				// if C == 0, then next code value is count value.
 				if(GETARG_C(op_intr) == 0) {
@@ -808,12 +1597,26 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 					if(ttisnumber(rc)) op_hints[i] |= HINT_C_NUM_CONSTANT;
 				}
 				break;
+			case OP_CALL:
+				// speculate that calls to math library functions call the unmodified functions.
+				if(OptLevel > 1 && vm_math_guard != NULL) {
+					int math_id = find_math_call(p, i);
+					if(math_id >= 0) {
+						op_hints[i] |= HINT_MATH_CALL;
+						op_values[i] = new OPValues(1);
+						op_values[i]->set(0, llvm::ConstantInt::get(getCtx(), llvm::APInt(32, math_id)));
+						need_op_block[i + 1] = true; /* fast path jumps over the call. */
+					}
+				}
+				break;
 			default:
 				break;
 		}
 		// update local variable type hints.
 		//vm_op_hint_locals(locals, p->maxstacksize, k, op_intr);
 	}
+	// write barriers and GC checks, needs all basic blocks.
+	hint_gc_ops(p);
 	// pre-create basic blocks.
 	for(i = 0; i < code_len; i++) {
 		if(need_op_block[i]) {
@@ -855,7 +1658,7 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 			int op_count = 1;
 			// count mini ops and check for any branch end-points.
 			while(is_mini_vm_op(GET_OPCODE(code[i + op_count])) &&
-					(op_hints[i + op_count] & HINT_SKIP_OP) == 0) {
+					(op_hints[i + op_count] & (HINT_SKIP_OP | HINT_FOR_IDX | HINT_SCALAR_TABLE)) == 0) {
 				// branch end-point in middle of mini ops block.
 				if(need_op_block[i + op_count]) {
 					op_hints[i + op_count] |= HINT_MINI_VM; // mark start of new mini vm ops.
@@ -904,6 +1707,11 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 		if(DebugOpCodes) {
 			/* vm_next_OP function is used to call count/line debug hooks. */
 			Builder.CreateCall3(vm_next_OP, func_L, func_cl, llvm::ConstantInt::get(getCtx(), llvm::APInt(32,i)));
+		} else if(!NoHookChecks && vm_check_hook != NULL && is_hook_check_op(op_intr)) {
+			/* without '-g' only check for count/line hooks at loop back-edges and calls. */
+			call = Builder.CreateCall3(vm_check_hook, func_L, func_cl,
+				llvm::ConstantInt::get(getCtx(), llvm::APInt(32,i)));
+			inlineList.push_back(call);
 		}
 		if(op_hints[i] & HINT_SKIP_OP) {
 			if(strip_code) strip_ops++;
@@ -971,6 +1779,119 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 				vals->set(0, PN);
 			}
 		}
+		// inline math library call, guarded by a check of the called function and argument types.
+		if(op_hints[i] & HINT_MATH_CALL) {
+			llvm::ConstantInt *math_id = llvm::cast<llvm::ConstantInt>(op_values[i]->get(0));
+			int ra = GETARG_A(op_intr);
+			int nargs = GETARG_B(op_intr) - 1;
+			llvm::BasicBlock *math_block;
+			llvm::BasicBlock *call_block;
+			llvm::Value *x, *y = NULL;
+			llvm::CallInst *call2;
+
+			call2 = Builder.CreateCall4(vm_math_guard, func_L,
+				llvm::ConstantInt::get(getCtx(), llvm::APInt(32, ra)),
+				llvm::ConstantInt::get(getCtx(), llvm::APInt(32, nargs)), math_id, "math_guard");
+			inlineList.push_back(call2);
+			brcond = Builder.CreateICmpNE(call2, llvm::ConstantInt::get(getCtx(), llvm::APInt(32,0)), "brcond");
+			snprintf(name_buf,128,"op_block_%s_%d_math",luaP_opnames[opcode],i);
+			math_block = llvm::BasicBlock::Create(getCtx(),name_buf, func);
+			snprintf(name_buf,128,"op_block_%s_%d_call",luaP_opnames[opcode],i);
+			call_block = llvm::BasicBlock::Create(getCtx(),name_buf, func);
+			Builder.CreateCondBr(brcond, math_block, call_block);
+			// inline math function.
+			Builder.SetInsertPoint(math_block);
+			call2 = Builder.CreateCall2(vm_get_number, func_L,
+				llvm::ConstantInt::get(getCtx(), llvm::APInt(32, ra + 1)), "math_x");
+			inlineList.push_back(call2);
+			x = call2;
+			if(nargs > 1) {
+				call2 = Builder.CreateCall2(vm_get_number, func_L,
+					llvm::ConstantInt::get(getCtx(), llvm::APInt(32, ra + 2)), "math_y");
+				inlineList.push_back(call2);
+				y = call2;
+			}
+			x = emit_math_call(Builder, math_id->getZExtValue(), x, y);
+			call2 = Builder.CreateCall3(vm_set_number, func_L,
+				llvm::ConstantInt::get(getCtx(), llvm::APInt(32, ra)), x);
+			inlineList.push_back(call2);
+			Builder.CreateBr(op_blocks[i + 1]);
+			// normal call.
+			current_block = call_block;
+			Builder.SetInsertPoint(current_block);
+		}
+		// scalar replaced table: use the field variables until the real table is created.
+		if(op_hints[i] & HINT_SCALAR_TABLE) {
+			OPValues *vals = op_values[i];
+			int nfields = (vals->size() - 2) / 2;
+			llvm::Value *zero = llvm::ConstantInt::get(getCtx(), llvm::APInt(32,0));
+			llvm::BasicBlock *scalar_block;
+			llvm::BasicBlock *table_block;
+			llvm::CallInst *call2;
+
+			if(opcode == OP_NEWTABLE) {
+				Builder.CreateStore(zero, vals->get(0));
+				for(int x = 0; x < nfields; x++) {
+					Builder.CreateStore(llvm::Constant::getNullValue(Ty_TValue), vals->get(3 + 2 * x));
+				}
+			} else {
+				brcond = Builder.CreateICmpEQ(Builder.CreateLoad(vals->get(0)), zero, "is_scalar");
+				snprintf(name_buf,128,"op_block_%s_%d_scalar",luaP_opnames[opcode],i);
+				scalar_block = llvm::BasicBlock::Create(getCtx(),name_buf, func);
+				snprintf(name_buf,128,"op_block_%s_%d_table",luaP_opnames[opcode],i);
+				table_block = llvm::BasicBlock::Create(getCtx(),name_buf, func);
+				Builder.CreateCondBr(brcond, scalar_block, table_block);
+				Builder.SetInsertPoint(scalar_block);
+				if(opcode == OP_GETTABLE) {
+					call2 = Builder.CreateCall3(vm_scalar_get, func_L, vals->get(1),
+						llvm::ConstantInt::get(getCtx(), llvm::APInt(32,GETARG_A(op_intr))));
+					inlineList.push_back(call2);
+					Builder.CreateBr(op_blocks[i + 1]);
+				} else {
+					llvm::BasicBlock *create_block;
+					std::vector<llvm::Value*> set_args;
+
+					call2 = Builder.CreateCall4(vm_scalar_set, func_L, func_k, vals->get(1),
+						llvm::ConstantInt::get(getCtx(), llvm::APInt(32,GETARG_C(op_intr))), "retval");
+					inlineList.push_back(call2);
+					brcond = Builder.CreateICmpNE(call2, zero, "brcond");
+					snprintf(name_buf,128,"op_block_%s_%d_create_table",luaP_opnames[opcode],i);
+					create_block = llvm::BasicBlock::Create(getCtx(),name_buf, func);
+					Builder.CreateCondBr(brcond, op_blocks[i + 1], create_block);
+					// collectable value: move the fields into a real table.
+					Builder.SetInsertPoint(create_block);
+					call2 = Builder.CreateCall3(vm_scalar_newtable, func_L,
+						llvm::ConstantInt::get(getCtx(), llvm::APInt(32,GETARG_A(op_intr))),
+						llvm::ConstantInt::get(getCtx(), llvm::APInt(32,nfields)));
+					inlineList.push_back(call2);
+					for(int x = 0; x < nfields; x++) {
+						set_args.clear();
+						set_args.push_back(func_L);
+						set_args.push_back(func_k);
+						set_args.push_back(llvm::ConstantInt::get(getCtx(), llvm::APInt(32,GETARG_A(op_intr))));
+						set_args.push_back(vals->get(2 + 2 * x));
+						set_args.push_back(vals->get(3 + 2 * x));
+						call2 = Builder.CreateCall(vm_scalar_setfield, set_args);
+						inlineList.push_back(call2);
+					}
+					Builder.CreateStore(llvm::ConstantInt::get(getCtx(), llvm::APInt(32,1)), vals->get(0));
+					Builder.CreateBr(table_block);
+				}
+				// normal table op.
+				current_block = table_block;
+				Builder.SetInsertPoint(current_block);
+			}
+		}
+		// table ops indexed by a for loop variable get the current index from the 'for_idx' variable.
+		if(op_hints[i] & HINT_FOR_IDX) {
+			llvm::Value *idx = Builder.CreateLoad(op_values[i]->get(1), "for_idx");
+			// key computed from the index: 'idx * mul + add'.
+			if(op_values[i]->size() > 2) {
+				idx = Builder.CreateNSWMul(idx, op_values[i]->get(2), "idx_mul");
+				idx = Builder.CreateNSWAdd(idx, op_values[i]->get(3), "idx_key");
+			}
+			op_values[i]->set(0, idx);
+		}
 		args.clear();
 		for(int x = 0; func_info->params[x] != VAR_T_VOID ; x++) {
 			llvm::Value *val=NULL;
@@ -1041,6 +1962,9 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 			case VAR_T_OP_VALUE_2:
 				if(op_values[i] != NULL) val = op_values[i]->get(2);
 				break;
+			case VAR_T_OP_VALUE_0_PTR:
+				if(op_values[i] != NULL) val = op_values[i]->get(0);
+				break;
 			default:
 				fprintf(stderr, "Error: not implemented!\n");
 				return;
@@ -1127,8 +2051,8 @@ void LLVMCompiler::compile(lua_State *L, Proto *p)
 			case OP_LE:
 			case OP_TEST:
 			case OP_TESTSET:
-				inline_call = true;
 			case OP_TFORLOOP:
+				inline_call = true;
 				brcond=call;
 				brcond=Builder.CreateICmpNE(brcond, llvm::ConstantInt::get(getCtx(), llvm::APInt(32,0)), "brcond");
 				false_block=op_blocks[branch+1];
@@ -1339,3 +2263,22 @@ void LLVMCompiler::free(lua_State *L, Proto *p)
 	}
 }
 
+
+unsigned int LLVMCompiler::getOptLevel()
+{
+	return OptLevel;
+}
+
+std::string LLVMCompiler::get_options_key()
+{
+	char buf[256];
+
+	// every option that changes the generated code must be listed here, the AOT
+	// bitcode cache uses this string as part of the cache key.  The build of the
+	// compiler is included, a rebuilt compiler may generate different code.
+	snprintf(buf, sizeof(buf), LLVM_LUA_VERSION " (" __DATE__ " " __TIME__ ") O%u fast=%d g=%d strip=%d stats=%d print=%d large=%d max=%d noinline=%d nohook=%d",
+		OptLevel, (int)Fast, (int)DebugOpCodes, (int)strip_code,
+		(int)RunOpCodeStats, (int)PrintRunOpCodes, (int)CompileLargeFunctions,
+		(int)MaxFunctionSize, (int)DontInlineOpcodes, (int)NoHookChecks);
+	return std::string(buf);
+}
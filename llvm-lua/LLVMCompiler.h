@@ -28,6 +28,7 @@
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Module.h"
 #include "llvm/LLVMContext.h"
+#include <string>
 
 #include "lua_core.h"
 
@@ -87,6 +88,9 @@ private:
 			assert(idx >= 0 && idx < len);
 			return values[idx];
 		}
+		int size() {
+			return len;
+		}
 	};
 
 private:
@@ -118,8 +122,17 @@ private:
 	llvm::Function *vm_print_OP;
 	// function for handling count/line debug hooks.
 	llvm::Function *vm_next_OP;
+	// function to check for count/line debug hooks at back-edges and calls.
+	llvm::Function *vm_check_hook;
 	// function for handling a block of simple opcodes.
 	llvm::Function *vm_mini_vm;
+	// function to check a speculated math library call.
+	llvm::Function *vm_math_guard;
+	// functions for tables replaced by local variables.
+	llvm::Function *vm_scalar_set;
+	llvm::Function *vm_scalar_get;
+	llvm::Function *vm_scalar_newtable;
+	llvm::Function *vm_scalar_setfield;
 	// available op function for each opcode.
 	OPFunc **vm_op_funcs;
 	// count compiled opcodes.
@@ -139,6 +152,21 @@ private:
 	void resize_opcode_data(int code_len);
 	// reset/clear the opcode hint data arrays.
 	void clear_opcode_data(int code_len);
+	// hint table ops indexed by a numeric for loop variable.
+	void hint_for_idx_ops(Proto *p, int start, int end, int idx_reg,
+		hint_t hint, llvm::Value *idx_var);
+	// hint table ops with keys computed from a lua_Long for loop variable.
+	void hint_for_int_keys(Proto *p, int start, int end, int idx_reg, OPValues *loop_vals);
+	// guess the math library function called by an OP_CALL.
+	int find_math_call(Proto *p, int pc);
+	// emit inline code for a math library function.
+	llvm::Value *emit_math_call(llvm::IRBuilder<> &Builder, int id, llvm::Value *x, llvm::Value *y);
+	// replace a table that doesn't escape the function with local variables.
+	void hint_scalar_table(Proto *p, int pc, llvm::IRBuilder<> &Builder);
+	// check if a register never holds a collectable value at an op.
+	bool reg_not_collectable(Proto *p, int pc, int reg);
+	// drop write barriers and merge GC checks.
+	void hint_gc_ops(Proto *p);
 
 public:
 	LLVMCompiler(int useJIT);
@@ -169,6 +197,16 @@ public:
 	llvm::Type *get_var_type(val_t type, hint_t hints);
 
 	llvm::Value *get_proto_constant(TValue *constant);
+
+	/*
+	 * return the optimization level (0-3).
+	 */
+	unsigned int getOptLevel();
+
+	/*
+	 * return a string describing all options that effect the generated code.
+	 */
+	std::string get_options_key();
 	
 	/*
 	 * Pre-Compile all loaded functions.
@@ -26,20 +26,41 @@
 #include "llvm/Module.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Linker.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/PassManager.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include <string>
 #include <vector>
 #include <fstream>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "LLVMCompiler.h"
 #include "LLVMDumper.h"
+#include "llvm_lua_config.h"
 #include "lstate.h"
 #include "load_jit_proto.h"
 #include "load_liblua_main.h"
+#include "load_vm_ops.h"
+
+extern "C" {
+#include "lundump.h"
+}
 
 static llvm::cl::opt<bool> LuaModule("lua-module",
                    llvm::cl::desc("Generate a Lua Module instead of a standalone exe."),
@@ -49,6 +70,131 @@ static llvm::cl::opt<bool> NoMain("no-main",
                    llvm::cl::desc("Don't link in liblua_main.bc."),
                    llvm::cl::init(false));
 
+enum OutputType {
+	OutputBitcode,
+	OutputObject,
+	OutputExe,
+	OutputShared
+};
+
+static llvm::cl::opt<OutputType> FileType("filetype",
+                   llvm::cl::desc("Type of output file."),
+                   llvm::cl::values(
+                     clEnumValN(OutputBitcode, "bc", "LLVM bitcode (default)"),
+                     clEnumValN(OutputObject, "obj", "Native object file"),
+                     clEnumValN(OutputExe, "exe", "Standalone executable"),
+                     clEnumValEnd),
+                   llvm::cl::init(OutputBitcode));
+
+static llvm::cl::opt<bool> Shared("shared",
+                   llvm::cl::desc("Generate a Lua Module as a shared library."),
+                   llvm::cl::init(false));
+
+static llvm::cl::opt<std::string> MArch("march",
+                   llvm::cl::desc("Architecture to generate code for (see -version), it must be the one llvm-lua was built for."),
+                   llvm::cl::value_desc("arch"),
+                   llvm::cl::init(""));
+
+static llvm::cl::opt<std::string> MCPU("mcpu",
+                   llvm::cl::desc("Target a specific cpu type ('native' for the host cpu)."),
+                   llvm::cl::value_desc("cpu-name"),
+                   llvm::cl::init(""));
+
+static llvm::cl::list<std::string> MAttrs("mattr",
+                   llvm::cl::CommaSeparated,
+                   llvm::cl::desc("Target specific attributes (-mattr=help for details)."),
+                   llvm::cl::value_desc("a1,+a2,-a3,..."));
+
+static llvm::cl::opt<std::string> LinkerCC("cc",
+                   llvm::cl::desc("C compiler used to link executables."),
+                   llvm::cl::value_desc("program"),
+                   llvm::cl::init("cc"));
+
+static llvm::cl::list<std::string> CCFlags("ccflag",
+                   llvm::cl::desc("Extra flag passed to the C compiler when linking."),
+                   llvm::cl::value_desc("flag"));
+
+static llvm::cl::list<std::string> CCLibs("cclib",
+                   llvm::cl::desc("Extra library linked into executables ('-cclib=readline' for -lreadline)."),
+                   llvm::cl::value_desc("name"));
+
+static llvm::cl::opt<std::string> CacheDir("cache-dir",
+                   llvm::cl::desc("Re-use outputs from 'dir' when the Lua code, options & llvm-luac build are unchanged."),
+                   llvm::cl::value_desc("dir"),
+                   llvm::cl::init(""));
+
+static bool has_suffix(const char *str, const char *suffix) {
+	size_t len = strlen(str);
+	size_t suffix_len = strlen(suffix);
+	return len >= suffix_len && strcmp(str + (len - suffix_len), suffix) == 0;
+}
+
+static OutputType get_output_type(const char *output) {
+	if(Shared) return OutputShared;
+	// '-o foo.o' without a '-filetype' option, an explicit '-filetype=bc' is kept.
+	if(FileType.getNumOccurrences() == 0 && output != NULL && has_suffix(output, ".o")) return OutputObject;
+	return FileType;
+}
+
+/*
+ * file extension of the cached outputs.
+ */
+static const char *get_output_ext(OutputType type) {
+	switch(type) {
+	case OutputObject: return ".o";
+#if defined(_WIN32)
+	case OutputExe: return ".exe";
+	case OutputShared: return ".dll";
+#else
+	case OutputExe: return "";
+	case OutputShared: return ".so";
+#endif
+	default: break;
+	}
+	return ".bc";
+}
+
+static bool is_lua_module() {
+	return LuaModule || Shared;
+}
+
+//===----------------------------------------------------------------------===//
+// Output cache.
+//===----------------------------------------------------------------------===//
+
+/*
+ * 64-bit FNV-1a hash, only used to name the cached output files.
+ */
+static uint64_t cache_hash(uint64_t hash, const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char *)data;
+	while(len-- > 0) {
+		hash ^= *p++;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static int cache_hash_writer(lua_State *L, const void *p, size_t size, void *ud) {
+	uint64_t *hash = (uint64_t *)ud;
+	(void)L;
+	*hash = cache_hash(*hash, p, size);
+	return 0;
+}
+
+static bool copy_file(const std::string &from, const std::string &to) {
+	struct stat st;
+	std::ifstream in(from.c_str(), std::ios::in | std::ios::binary);
+	if(!in) return false;
+	std::ofstream out(to.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!out) return false;
+	out << in.rdbuf();
+	out.close();
+	if(out.fail()) return false;
+	// keep executables & shared modules executable.
+	if(stat(from.c_str(), &st) == 0) chmod(to.c_str(), st.st_mode & 07777);
+	return true;
+}
+
 //===----------------------------------------------------------------------===//
 // Dump a compilable bitcode module.
 //===----------------------------------------------------------------------===//
@@ -179,48 +325,324 @@ LLVMDumper::LLVMDumper(LLVMCompiler *compiler_) : compiler(compiler_) {
 	Ty_jit_proto_ptr = llvm::PointerType::get(Ty_jit_proto, 0);
 }
 
-void LLVMDumper::dump(const char *output, lua_State *L, Proto *p, int stripping) {
-	llvm::raw_fd_ostream *out;
+std::string LLVMDumper::get_cache_file(const char *output, lua_State *L, Proto *p, int stripping,
+	int link_requires) {
+	const unsigned char *bc;
+	std::string key;
+	uint64_t hash = 14695981039346656037ULL;
+	size_t len;
+	char name[32];
+
+	// Lua bytecode of the main chunk and all sub-functions (this includes any '-L' preloads).
+	luaU_dump(L, p, cache_hash_writer, &hash, stripping);
+	key = getstr(p->source);
+	// the linker side of llvm-luac (link_output, target selection) is part of the output too.
+	key.append(" " LLVM_LUA_VERSION " (" __DATE__ " " __TIME__ ")");
+	// compiler options & the module name (used to name the 'luaopen_*' function)
+	compiler->setStripCode(stripping);
+	key.append(compiler->get_options_key());
+	if(is_lua_module()) {
+		key.append(" lua-module=");
+		key.append(output);
+	}
+	if(NoMain) key.append(" no-main");
+	if(link_requires) key.append(" link-requires");
+	snprintf(name, sizeof(name), " filetype=%d", (int)get_output_type(output));
+	key.append(name);
+	if(get_output_type(output) != OutputBitcode) {
+		key.append(" march=");
+		key.append(MArch);
+		key.append(" mcpu=");
+		key.append(MCPU);
+		for(unsigned i = 0; i < MAttrs.size(); i++) {
+			key.append(" mattr=");
+			key.append(MAttrs[i]);
+		}
+		for(unsigned i = 0; i < CCFlags.size(); i++) {
+			key.append(" ccflag=");
+			key.append(CCFlags[i]);
+		}
+		for(unsigned i = 0; i < CCLibs.size(); i++) {
+			key.append(" cclib=");
+			key.append(CCLibs[i]);
+		}
+	}
+	hash = cache_hash(hash, key.data(), key.size());
+	// the embedded opcode functions & main code are part of the output too.
+	bc = get_vm_ops_bc(&len);
+	hash = cache_hash(hash, bc, len);
+	if(!is_lua_module() && !NoMain) {
+		bc = get_liblua_main_bc(&len);
+		hash = cache_hash(hash, bc, len);
+	}
+
+	snprintf(name, sizeof(name), "/%016llx%s", (unsigned long long)hash,
+		get_output_ext(get_output_type(output)));
+	return CacheDir + name;
+}
+
+void LLVMDumper::dump(const char *output, lua_State *L, Proto *p, int stripping, int link_requires) {
 	std::string error;
+	std::string cache_file;
 	llvm::Module *liblua_main = NULL;
+	OutputType output_type = get_output_type(output);
 
-	out = new llvm::raw_fd_ostream(output, error, llvm::raw_fd_ostream::F_Binary);
-	if(error.empty()) {
-		compiler->setStripCode(stripping);
-		// Internalize all opcode functions.
-		for (llvm::Module::iterator I = M->begin(), E = M->end(); I != E; ++I) {
-			llvm::Function *Fn = &*I;
-			if (!Fn->isDeclaration())
-				Fn->setLinkage(llvm::GlobalValue::getLinkOnceLinkage(true));
-		}
-		// Compile all Lua prototypes to LLVM IR
-		compiler->compileAll(L, p);
-		if(LuaModule) {
-			// Dump proto info to static variable and create 'luaopen_<mod_name>' function.
-			dump_lua_module(p, output);
-		} else {
-			// Dump proto info to global for standalone exe.
-			dump_standalone(p);
-			// link with liblua_main.bc
-			if(!NoMain) {
-				liblua_main = load_liblua_main(getCtx(), true);
-				if(llvm::Linker::LinkModules(M, liblua_main, llvm::Linker::DestroySource, &error)) {
-					fprintf(stderr, "Failed to link compiled Lua script with embedded 'liblua_main.bc': %s",
-						error.c_str());
-					exit(1);
-				}
+	if(output_type == OutputExe && is_lua_module()) {
+		fprintf(stderr, "Lua modules can't be linked as an executable, use '-shared'.\n");
+		exit(1);
+	}
+	if(!CacheDir.empty()) {
+		cache_file = get_cache_file(output, L, p, stripping, link_requires);
+		// re-use the cached output if nothing has changed.
+		if(copy_file(cache_file, output)) return;
+	}
+
+	compiler->setStripCode(stripping);
+	// Internalize all opcode functions.
+	for (llvm::Module::iterator I = M->begin(), E = M->end(); I != E; ++I) {
+		llvm::Function *Fn = &*I;
+		if (!Fn->isDeclaration())
+			Fn->setLinkage(llvm::GlobalValue::getLinkOnceLinkage(true));
+	}
+	// Compile all Lua prototypes to LLVM IR
+	compiler->compileAll(L, p);
+	if(is_lua_module()) {
+		// Dump proto info to static variable and create 'luaopen_<mod_name>' function.
+		dump_lua_module(p, output);
+	} else {
+		// Dump proto info to global for standalone exe.
+		dump_standalone(p);
+		// link with liblua_main.bc
+		if(!NoMain) {
+			liblua_main = load_liblua_main(getCtx(), true);
+			if(llvm::Linker::LinkModules(M, liblua_main, llvm::Linker::DestroySource, &error)) {
+				fprintf(stderr, "Failed to link compiled Lua script with embedded 'liblua_main.bc': %s",
+					error.c_str());
+				exit(1);
 			}
 		}
+	}
 
-		llvm::verifyModule(*M);
-		llvm::WriteBitcodeToFile(M, *out);
-		delete out;
-	} else {
-		delete out;
+	if(link_requires) {
+		optimize_linked_modules(p);
+	}
+
+	llvm::verifyModule(*M);
+	switch(output_type) {
+	case OutputBitcode:
+		write_bitcode(output);
+		break;
+	case OutputObject:
+		optimize_module();
+		write_object(output);
+		break;
+	case OutputExe:
+	case OutputShared:
+		optimize_module();
+		link_output(output, output_type == OutputShared);
+		break;
+	}
+
+	// save a copy of the output in the cache.
+	if(!cache_file.empty()) {
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), ".%d.tmp", (int)getpid());
+		std::string tmp_file = cache_file + tmp;
+		// rename() makes sure that other compilers never see a partial file.
+		if(!copy_file(output, tmp_file) || rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+			unlink(tmp_file.c_str());
+		}
+	}
+}
+
+void LLVMDumper::write_bitcode(const char *output) {
+	std::string error;
+	llvm::raw_fd_ostream out(output, error, llvm::raw_fd_ostream::F_Binary);
+
+	if(!error.empty()) {
 		fprintf(stderr, "Failed to open output file: %s",
 			error.c_str());
 		exit(1);
 	}
+	llvm::WriteBitcodeToFile(M, out);
+}
+
+/*
+ * Run the same module level optimizations as 'opt -O<level>'.
+ */
+void LLVMDumper::optimize_module() {
+	llvm::PassManagerBuilder Builder;
+	llvm::FunctionPassManager FPM(M);
+	llvm::PassManager PM;
+	unsigned int opt_level = compiler->getOptLevel();
+
+	if(opt_level == 0) return;
+	Builder.OptLevel = opt_level;
+	if(opt_level > 1) {
+		Builder.Inliner = llvm::createFunctionInliningPass();
+	}
+	FPM.add(new llvm::TargetData(M));
+	PM.add(new llvm::TargetData(M));
+	Builder.populateFunctionPassManager(FPM);
+	Builder.populateModulePassManager(PM);
+
+	FPM.doInitialization();
+	for (llvm::Module::iterator I = M->begin(), E = M->end(); I != E; ++I) {
+		FPM.run(*I);
+	}
+	FPM.doFinalization();
+	PM.run(*M);
+}
+
+llvm::TargetMachine *LLVMDumper::get_target_machine() {
+	std::string error;
+	std::string triple = M->getTargetTriple();
+	const llvm::Target *target;
+	llvm::TargetOptions options;
+	llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Default;
+	llvm::Reloc::Model reloc = llvm::Reloc::Default;
+	std::string cpu = MCPU;
+	std::string features;
+
+	// the opcode functions were compiled for this target.
+	if(triple.empty()) {
+		triple = llvm::sys::getDefaultTargetTriple();
+	}
+	if(!MArch.empty()) {
+		// pick the target by name like llc, but the opcode functions & liblua_main only
+		// fit the architecture they were compiled for, so no cross code generation.
+		llvm::Triple::ArchType arch = llvm::Triple::getArchTypeForLLVMName(MArch);
+		target = NULL;
+		for(llvm::TargetRegistry::iterator it = llvm::TargetRegistry::begin(),
+				ie = llvm::TargetRegistry::end(); it != ie; ++it) {
+			if(MArch == it->getName()) {
+				target = &*it;
+				break;
+			}
+		}
+		if(target == NULL) {
+			fprintf(stderr, "Unknown architecture '%s', see -version for the registered targets.\n",
+				MArch.c_str());
+			exit(1);
+		}
+		if(arch != llvm::Triple(triple).getArch()) {
+			fprintf(stderr, "Architecture '%s' doesn't match '%s', the target llvm-lua was built for.\n",
+				MArch.c_str(), triple.c_str());
+			exit(1);
+		}
+	} else {
+		target = llvm::TargetRegistry::lookupTarget(triple, error);
+		if(target == NULL) {
+			fprintf(stderr, "Failed to find target '%s': %s\n", triple.c_str(), error.c_str());
+			exit(1);
+		}
+	}
+	if(compiler->getOptLevel() == 0) {
+		opt_level = llvm::CodeGenOpt::None;
+	} else if(compiler->getOptLevel() > 2) {
+		opt_level = llvm::CodeGenOpt::Aggressive;
+	}
+	if(is_lua_module()) {
+		reloc = llvm::Reloc::PIC_;
+	}
+	if(cpu == "native") {
+		cpu = llvm::sys::getHostCPUName();
+	}
+	if(MAttrs.size() > 0) {
+		llvm::SubtargetFeatures Features;
+		for(unsigned i = 0; i < MAttrs.size(); i++) {
+			Features.AddFeature(MAttrs[i]);
+		}
+		features = Features.getString();
+	}
+	return target->createTargetMachine(triple, cpu, features, options, reloc,
+		llvm::CodeModel::Default, opt_level);
+}
+
+void LLVMDumper::write_object(const char *output) {
+	llvm::TargetMachine *TM = get_target_machine();
+	llvm::PassManager PM;
+	std::string error;
+
+	PM.add(new llvm::TargetData(*TM->getTargetData()));
+	{
+		llvm::raw_fd_ostream out(output, error, llvm::raw_fd_ostream::F_Binary);
+		if(!error.empty()) {
+			fprintf(stderr, "Failed to open output file: %s",
+				error.c_str());
+			exit(1);
+		}
+		llvm::formatted_raw_ostream fout(out);
+		if(TM->addPassesToEmitFile(PM, fout, llvm::TargetMachine::CGFT_ObjectFile, true)) {
+			fprintf(stderr, "Target '%s' can't emit object files.\n", TM->getTargetTriple().str().c_str());
+			exit(1);
+		}
+		PM.run(*M);
+	}
+	delete TM;
+}
+
+/*
+ * The object file already contains liblua_main (or only needs the Lua C API
+ * for shared modules), so the C compiler is only used to call the system linker.
+ */
+void LLVMDumper::link_output(const char *output, bool shared) {
+	std::string obj_file = std::string(output) + ".XXXXXX.o";
+	std::vector<const char *> args;
+	std::vector<std::string> libs;
+	std::string error;
+	llvm::sys::Path cc;
+	int ret;
+	int fd;
+
+	// unique name, parallel builds of the same output don't share the object file.
+	fd = mkstemps(&obj_file[0], 2);
+	if(fd < 0) {
+		fprintf(stderr, "Failed to create temporary object file for '%s'.\n", output);
+		exit(1);
+	}
+	close(fd);
+	write_object(obj_file.c_str());
+
+	cc = llvm::sys::Program::FindProgramByName(LinkerCC);
+	if(cc.isEmpty()) {
+		unlink(obj_file.c_str());
+		fprintf(stderr, "Failed to find C compiler '%s' for linking.\n", LinkerCC.c_str());
+		exit(1);
+	}
+	args.push_back(LinkerCC.c_str());
+	for(unsigned i = 0; i < CCFlags.size(); i++) {
+		args.push_back(CCFlags[i].c_str());
+	}
+	if(shared) {
+		args.push_back("-shared");
+	} else {
+		args.push_back("-Wl,-E"); // export Lua C API for C modules.
+	}
+	args.push_back("-o");
+	args.push_back(output);
+	args.push_back(obj_file.c_str());
+	if(!shared) {
+		// the libraries liblua_main needs, the core was built with the same options.
+		libs.push_back("-lm");
+		libs.push_back("-ldl");
+#if defined(LUA_USE_BGFREE)
+		libs.push_back("-lpthread");
+#endif
+		for(unsigned i = 0; i < CCLibs.size(); i++) {
+			libs.push_back("-l" + CCLibs[i]);
+		}
+		for(unsigned i = 0; i < libs.size(); i++) {
+			args.push_back(libs[i].c_str());
+		}
+	}
+	args.push_back(NULL);
+	ret = llvm::sys::Program::ExecuteAndWait(cc, &args[0], NULL, NULL, 0, 0, &error);
+	unlink(obj_file.c_str());
+	if(ret != 0) {
+		fprintf(stderr, "Failed to link '%s': %s\n", output, error.c_str());
+		exit(1);
+	}
 }
 
 llvm::Constant *LLVMDumper::get_ptr(llvm::Constant *val) {
@@ -464,16 +886,15 @@ void LLVMDumper::dump_lua_module(Proto *p, std::string mod_name) {
 	// normalize mod_name.
 	//
 
-	// remove '.bc' from end of mod_name.
-	n = mod_name.size()-3;
-	if(n > 0) {
-		tmp = mod_name.substr(n, 3);
-		if(tmp[0] == '.') {
-			if(tmp[1] == 'b' || tmp[1] == 'B') {
-				if(tmp[2] == 'c' || tmp[2] == 'C') {
-					mod_name = mod_name.substr(0, n);
-				}
-			}
+	// remove '.bc', '.o' or '.so' from end of mod_name.
+	n = mod_name.rfind('.');
+	if(n != std::string::npos && n > 0) {
+		tmp = mod_name.substr(n + 1);
+		for(size_t i = 0; i < tmp.size(); i++) {
+			if(tmp[i] >= 'A' && tmp[i] <= 'Z') tmp[i] += 'a' - 'A';
+		}
+		if(tmp == "bc" || tmp == "o" || tmp == "so") {
+			mod_name = mod_name.substr(0, n);
 		}
 	}
 	// convert non-alphanum chars to '_'
@@ -523,3 +944,33 @@ void LLVMDumper::dump_lua_module(Proto *p, std::string mod_name) {
 	//func->dump();
 }
 
+void LLVMDumper::internalize_protos(Proto *p) {
+	llvm::Function *func = (llvm::Function *)p->func_ref;
+	// compiled Lua functions are only referenced from the jit_proto tables.
+	if(func) {
+		func->setLinkage(llvm::GlobalValue::InternalLinkage);
+	}
+	for(int i = 0; i < p->sizep; i++) {
+		internalize_protos(p->p[i]);
+	}
+}
+
+void LLVMDumper::optimize_linked_modules(Proto *p) {
+	llvm::PassManager PM;
+
+	internalize_protos(p);
+
+	PM.add(new llvm::TargetData(M));
+	// no cross-module optimization of Lua code: Lua functions only call each other through
+	// OP_CALL & the jit_proto tables, so there is nothing for inter-procedural passes to
+	// propagate or inline.  Merge the constants & strings repeated by the linked modules
+	// and drop the opcode/runtime functions nothing uses.
+	PM.add(llvm::createConstantMergePass());
+	PM.add(llvm::createGlobalDCEPass());
+	PM.run(*M);
+}
+
+bool LLVMDumper::native_output(const char *output) {
+	return get_output_type(output) != OutputBitcode;
+}
+
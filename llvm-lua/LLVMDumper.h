@@ -45,6 +45,7 @@ class StructType;
 class FunctionType;
 class Constant;
 class GlobalVariable;
+class TargetMachine;
 }
 
 class LLVMCompiler;
@@ -75,13 +76,21 @@ private:
 public:
 	LLVMDumper(LLVMCompiler *compiler);
 
-	void dump(const char *output, lua_State *L, Proto *p, int stripping);
+	void dump(const char *output, lua_State *L, Proto *p, int stripping, int link_requires);
+
+	/*
+	 * true when the output is an object file, executable or shared library.
+	 */
+	static bool native_output(const char *output);
 
 	llvm::LLVMContext& getCtx() const {
 		return compiler->getCtx();
 	}
 
 private:
+	std::string get_cache_file(const char *output, lua_State *L, Proto *p, int stripping,
+		int link_requires);
+
 	llvm::Constant *get_ptr(llvm::Constant *val);
 
 	llvm::Constant *get_global_str(const char *str);
@@ -98,6 +107,20 @@ private:
 
 	void dump_lua_module(Proto *p, std::string mod_name);
 
+	void write_bitcode(const char *output);
+
+	void optimize_module();
+
+	llvm::TargetMachine *get_target_machine();
+
+	void write_object(const char *output);
+
+	void link_output(const char *output, bool shared);
+
+	void internalize_protos(Proto *p);
+
+	void optimize_linked_modules(Proto *p);
+
 };
 #endif
 
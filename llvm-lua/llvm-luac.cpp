@@ -49,6 +49,7 @@
 #include "llvm/Target/TargetMachine.h"
 
 #include "llvm_compiler.h"
+#include "llvm_dumper.h"
 #include "lua_compiler.h"
 
 namespace {
@@ -84,6 +85,10 @@ namespace {
   StripDebug("s",
             llvm::cl::desc("strip debug information"));
 
+  llvm::cl::opt<bool>
+  LinkRequires("link-requires",
+            llvm::cl::desc("preload all modules loaded with 'require \"name\"' into the output"));
+
   llvm::cl::opt<bool>
   ShowVersion("v",
             llvm::cl::desc("show version information"));
@@ -141,7 +146,8 @@ int main(int argc, char ** argv) {
 			arg_list.push_back(*I);
 		}
 	}
-	if(Bitcode) {
+	// object files & executables are generated from the bitcode.
+	if(Bitcode || llvm_dumper_native_output(Output.empty() ? NULL : Output.c_str())) {
 		arg_list.push_back("-bc");
 	}
 	for(std::vector<bool>::iterator I=ListOpcodes.begin(); I != ListOpcodes.end(); I++) {
@@ -157,6 +163,9 @@ int main(int argc, char ** argv) {
 	if(StripDebug) {
 		arg_list.push_back("-s");
 	}
+	if(LinkRequires) {
+		arg_list.push_back("-lr");
+	}
 	arg_list.insert(arg_list.end(),InputFiles.begin(), InputFiles.end());
 	/* construct luac_argc, luac_argv. */
 	new_argc = arg_list.size() + 1;
@@ -30,10 +30,14 @@
 
 extern "C" {
 
-void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping) {
+int llvm_dumper_native_output(const char *output) {
+	return LLVMDumper::native_output(output);
+}
+
+void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping, int link_requires) {
 	LLVMCompiler *compiler = llvm_get_compiler(L);
 	LLVMDumper *dumper = new LLVMDumper(compiler);
-	dumper->dump(output, L, p, stripping);
+	dumper->dump(output, L, p, stripping, link_requires);
 	delete dumper;
 }
 
@@ -33,7 +33,9 @@ extern "C" {
 
 #include "lobject.h"
 
-void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping);
+int llvm_dumper_native_output(const char *output);
+
+void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping, int link_requires);
 
 #ifdef __cplusplus
 }
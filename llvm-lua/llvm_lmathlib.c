@@ -18,6 +18,9 @@ extern "C" {
 
 #include "lauxlib.h"
 #include "lualib.h"
+#include "ldo.h"
+#include "lgc.h"
+#include "llvm_lmathlib.h"
 
 
 #undef PI
@@ -33,12 +36,11 @@ extern "C" {
 #define MATH_FASTCALL1(name, fname) \
 static int math_ ## name ## _precall (lua_State *L, StkId func, int nresults) { \
   StkId arg1 = func + 1; \
+  if(fastcall_hooked(L) || fastcall_nargs(L, func) < 1) goto fallback; \
   llvm_arg_tonumber(L, arg1, 1); \
+  fastcall_leave(L); \
   setnvalue(func, fname(nvalue(arg1))); \
-  L->ci--; \
-  L->top = func + 1; \
-  L->base = L->ci->base; \
-  return PCRC; \
+  fastcall_return(L, func, nresults, 1); \
 fallback: \
   return luaD_precall_c(L, func, nresults); \
 }
@@ -47,13 +49,12 @@ fallback: \
 static int math_ ## name ## _precall (lua_State *L, StkId func, int nresults) { \
   StkId arg1 = func + 1; \
   StkId arg2 = func + 2; \
+  if(fastcall_hooked(L) || fastcall_nargs(L, func) < 2) goto fallback; \
   llvm_arg_tonumber(L, arg1, 1); \
   llvm_arg_tonumber(L, arg2, 2); \
+  fastcall_leave(L); \
   setnvalue(func, fname(nvalue(arg1), nvalue(arg2))); \
-  L->ci--; \
-  L->top = func + 1; \
-  L->base = L->ci->base; \
-  return PCRC; \
+  fastcall_return(L, func, nresults, 1); \
 fallback: \
   return luaD_precall_c(L, func, nresults); \
 }
@@ -294,6 +295,31 @@ static int math_randomseed (lua_State *L) {
 }
 
 
+const lua_CFunction llvm_math_funcs[LLVM_MATH_COUNT] = {
+  math_abs,   /* LLVM_MATH_ABS */
+  math_acos,  /* LLVM_MATH_ACOS */
+  math_asin,  /* LLVM_MATH_ASIN */
+  math_atan,  /* LLVM_MATH_ATAN */
+  math_atan2, /* LLVM_MATH_ATAN2 */
+  math_ceil,  /* LLVM_MATH_CEIL */
+  math_cos,   /* LLVM_MATH_COS */
+  math_cosh,  /* LLVM_MATH_COSH */
+  math_deg,   /* LLVM_MATH_DEG */
+  math_exp,   /* LLVM_MATH_EXP */
+  math_floor, /* LLVM_MATH_FLOOR */
+  math_fmod,  /* LLVM_MATH_FMOD */
+  math_log,   /* LLVM_MATH_LOG */
+  math_log10, /* LLVM_MATH_LOG10 */
+  math_pow,   /* LLVM_MATH_POW */
+  math_rad,   /* LLVM_MATH_RAD */
+  math_sin,   /* LLVM_MATH_SIN */
+  math_sinh,  /* LLVM_MATH_SINH */
+  math_sqrt,  /* LLVM_MATH_SQRT */
+  math_tan,   /* LLVM_MATH_TAN */
+  math_tanh,  /* LLVM_MATH_TANH */
+};
+
+
 static const luaL_Reg3 mathlib[] = {
   {"abs",   math_abs, math_abs_precall},
   {"acos",  math_acos, math_acos_precall},
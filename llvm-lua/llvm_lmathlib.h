@@ -0,0 +1,39 @@
+/*
+** Math library functions that compiled code can call directly.
+** See Copyright Notice in lua.h
+*/
+
+#ifndef llvm_lmathlib_h
+#define llvm_lmathlib_h
+
+#include "lua.h"
+
+typedef enum {
+	LLVM_MATH_ABS,
+	LLVM_MATH_ACOS,
+	LLVM_MATH_ASIN,
+	LLVM_MATH_ATAN,
+	LLVM_MATH_ATAN2,
+	LLVM_MATH_CEIL,
+	LLVM_MATH_COS,
+	LLVM_MATH_COSH,
+	LLVM_MATH_DEG,
+	LLVM_MATH_EXP,
+	LLVM_MATH_FLOOR,
+	LLVM_MATH_FMOD,
+	LLVM_MATH_LOG,
+	LLVM_MATH_LOG10,
+	LLVM_MATH_POW,
+	LLVM_MATH_RAD,
+	LLVM_MATH_SIN,
+	LLVM_MATH_SINH,
+	LLVM_MATH_SQRT,
+	LLVM_MATH_TAN,
+	LLVM_MATH_TANH,
+	LLVM_MATH_COUNT
+} llvm_math_func;
+
+/* C functions of the math library, indexed by llvm_math_func. */
+extern const lua_CFunction llvm_math_funcs[LLVM_MATH_COUNT];
+
+#endif
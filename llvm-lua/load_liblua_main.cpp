@@ -37,3 +37,8 @@ llvm::Module *load_liblua_main(llvm::LLVMContext &context, bool NoLazyCompilatio
 		sizeof(liblua_main_bc), NoLazyCompilation);
 }
 
+const unsigned char *get_liblua_main_bc(size_t *len) {
+	*len = sizeof(liblua_main_bc);
+	return liblua_main_bc;
+}
+
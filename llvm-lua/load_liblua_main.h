@@ -27,5 +27,7 @@
 
 extern llvm::Module *load_liblua_main(llvm::LLVMContext &context, bool NoLazyCompilation);
 
+extern const unsigned char *get_liblua_main_bc(size_t *len);
+
 #endif
 
@@ -37,3 +37,8 @@ llvm::Module *load_vm_ops(llvm::LLVMContext &context, bool NoLazyCompilation) {
 		sizeof(lua_vm_ops_bc), NoLazyCompilation);
 }
 
+const unsigned char *get_vm_ops_bc(size_t *len) {
+	*len = sizeof(lua_vm_ops_bc);
+	return lua_vm_ops_bc;
+}
+
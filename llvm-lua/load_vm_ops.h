@@ -27,5 +27,7 @@
 
 extern llvm::Module *load_vm_ops(llvm::LLVMContext &context, bool NoLazyCompilation);
 
+extern const unsigned char *get_vm_ops_bc(size_t *len);
+
 #endif
 
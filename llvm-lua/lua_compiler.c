@@ -45,6 +45,7 @@ static int llvm_bitcode=0;/* output llvm bitcode? */
 static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
+static int link_requires=0;		/* preload modules of constant 'require' calls? */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -78,6 +79,7 @@ static void usage(const char* message) {
   "  -o name  output to file " LUA_QL("name") " (default is \"%s\")\n"
   "  -p       parse only\n"
   "  -s       strip debug information\n"
+  "  -lr      link requires: preload all modules loaded with 'require \"name\"'\n"
   "  -v       show version information\n"
   "  --       stop handling options\n",
   progname,Output);
@@ -116,6 +118,8 @@ static int doargs(int argc, char* argv[]) {
       parse_only=1;
     else if (IS("-s"))			/* strip debug information */
       stripping=1;
+    else if (IS("-lr"))			/* link requires */
+      link_requires=1;
     else if (IS("-v"))			/* show version */
       ++version;
     else					/* unknown option */
@@ -202,6 +206,63 @@ static int writer(lua_State* L, const void* p, size_t size, void* u) {
   return (fwrite(p,size,1,(FILE*)u)!=1) && (size!=0);
 }
 
+/*
+** add module 'name' to the preload list, the module is found with the
+** normal 'package.loaders'.  C modules & modules that can't be found are
+** left to the 'require' function at runtime, the standard libraries are
+** already loaded.
+*/
+static void preload_require(lua_State* L, const char* name) {
+  int i, loaded;
+  for (i=0; i<preloads; i++) {
+    if (strcmp(preload_libs[i],name)==0) return;  /* already preloaded */
+  }
+  lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+  lua_getfield(L, -1, name);
+  loaded=!lua_isnil(L, -1);
+  lua_pop(L, 2);
+  if (loaded) return;  /* a library opened by luaL_openlibs */
+  if (preloads >= MAX_PRELOADS) fatal(LUA_QL("-lr") " too many modules");
+  luaL_checkstack(L, 3, "too many modules");
+  lua_getglobal(L, "require");
+  lua_pushstring(L, name);
+  lua_pushboolean(L, 1);
+  if (lua_pcall(L, 2, 1, 0)!=0) {
+    fprintf(stderr,"%s: warning: can't preload module " LUA_QS ": %s\n",
+      progname,name,lua_tostring(L,-1));
+    lua_pop(L, 1);
+  } else if (!lua_isfunction(L, -1) || lua_iscfunction(L, -1)) {
+    lua_pop(L, 1);
+  } else {
+    preload_libs[preloads++]=(char*)name;  /* name is anchored by a constant */
+  }
+}
+
+/*
+** find 'require "name"' calls in function 'f' and all of it's sub-functions.
+*/
+static void find_requires(lua_State* L, const Proto* f) {
+  int pc,n;
+  for (pc=0; pc+2 < f->sizecode; pc++) {
+    Instruction i=f->code[pc];
+    const TValue* k;
+    int a;
+    /* GETGLOBAL A 'require'; LOADK A+1 'name'; CALL A 2 C */
+    if (GET_OPCODE(i)!=OP_GETGLOBAL) continue;
+    k=&f->k[GETARG_Bx(i)];
+    if (!ttisstring(k) || strcmp(svalue(k),"require")!=0) continue;
+    a=GETARG_A(i);
+    i=f->code[pc+1];
+    if (GET_OPCODE(i)!=OP_LOADK || GETARG_A(i)!=a+1) continue;
+    k=&f->k[GETARG_Bx(i)];
+    if (!ttisstring(k)) continue;
+    i=f->code[pc+2];
+    if (GET_OPCODE(i)!=OP_CALL || GETARG_A(i)!=a || GETARG_B(i)!=2) continue;
+    preload_require(L, svalue(k));
+  }
+  for (n=0; n<f->sizep; n++) find_requires(L, f->p[n]);
+}
+
 struct Smain {
   int argc;
   char** argv;
@@ -264,12 +325,17 @@ static int pmain(lua_State* L) {
       }
     }
   }
+  /* follow the 'require' calls of the scripts & all preloaded modules. */
+  if (link_requires) {
+    for (i=0; i<scripts+preloads; i++)
+      find_requires(L, toproto(L, i-scripts-preloads));
+  }
   /* generate a new Lua function to combine all of the compiled scripts. */
   f=combine(L, scripts);
   if (listing) luaU_print(f,listing>1);
   if (llvm_bitcode && !parse_only) {
     lua_lock(L);
-    llvm_dumper_dump(output, L, f, stripping);
+    llvm_dumper_dump(output, L, f, stripping, link_requires);
     lua_unlock(L);
   }
   if (dumping && !parse_only) {
@@ -46,6 +46,7 @@ void llvm_freeproto (lua_State *L, Proto *f);
 #include "lcode.c"
 #include "ldebug.c"
 #include "ldump.c"
+#include "lfastcall.c"
 #include "lfunc.c"
 #include "lgc.c"
 #include "llex.c"
@@ -14,6 +14,7 @@
 #include "lcode.c"
 #include "ldebug.c"
 #include "ldump.c"
+#include "lfastcall.c"
 #include "lfunc.c"
 #include "lgc.c"
 #include "llex.c"
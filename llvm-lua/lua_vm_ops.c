@@ -25,9 +25,23 @@ extern "C" {
 #include "ltable.h"
 #include "ltm.h"
 #include "lvm.h"
+#include "llvm_lmathlib.h"
 #include <stdio.h>
 #include <assert.h>
 
+/*
+ * Slow paths of the inlined ops.
+ */
+VM_COLD void vm_arith_slow(lua_State *L, TValue *ra, const TValue *rb, const TValue *rc, int op) {
+  luaV_arith(L, ra, rb, rc, (TMS)op);
+}
+
+VM_COLD void vm_len_slow(lua_State *L, TValue *ra, const TValue *rb) {
+  ptrdiff_t br = savestack(L, rb);
+  if (!luaV_call_binTM(L, rb, luaO_nilobject, ra, TM_LEN))
+    luaG_typeerror(L, restorestack(L, br), "get length of");
+}
+
 void vm_OP_MOVE(lua_State *L, int a, int b) {
   TValue *base = L->base;
   TValue *ra = base + a;
@@ -83,6 +97,54 @@ void vm_OP_GETTABLE(lua_State *L, TValue *k, int a, int b, int c) {
   luaV_gettable(L, base + b, RK(c), ra);
 }
 
+/*
+ * R(A) := R(B)[K(C)] with a string constant key, the node of the key is cached in the
+ * key slot of the op (see luaV_getstr).
+ */
+void vm_OP_GETTABLE_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset) {
+  TValue *base = L->base;
+  luaV_getstr(L, base + b, k + INDEXK(c), base + a,
+    luaF_keyslot(L, cl->p, pseudo_ops_offset - 1));
+}
+
+/*
+ * R(A) := R(B)[idx], where 'idx' is the index of the enclosing numeric for loop.
+ * Keys inside the array part are loaded directly, everything else falls back to luaV_gettable.
+ */
+void vm_OP_GETTABLE_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx) {
+  TValue *base = L->base;
+  TValue *rb = base + b;
+  int n;
+  lua_number2int(n, idx);
+  if (vm_likely(ttistable(rb) && luai_numeq(cast_num(n), idx))) {
+    Table *h = hvalue(rb);
+    if (n >= 1 && n <= h->sizearray) {
+      const TValue *v = &h->array[n-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_INDEX) == NULL) {
+        setobj2s(L, base + a, v);
+        return;
+      }
+    }
+  }
+  luaV_gettable(L, rb, RK(c), base + a);
+}
+
+void vm_OP_GETTABLE_long_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx) {
+  TValue *base = L->base;
+  TValue *rb = base + b;
+  if (vm_likely(ttistable(rb))) {
+    Table *h = hvalue(rb);
+    if (idx >= 1 && idx <= h->sizearray) {
+      const TValue *v = &h->array[idx-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_INDEX) == NULL) {
+        setobj2s(L, base + a, v);
+        return;
+      }
+    }
+  }
+  luaV_gettable(L, rb, RK(c), base + a);
+}
+
 void vm_OP_SETGLOBAL(lua_State *L, TValue *k, LClosure *cl, int a, int bx) {
   TValue *base = L->base;
   TValue *ra = base + a;
@@ -100,16 +162,122 @@ void vm_OP_SETUPVAL(lua_State *L, LClosure *cl, int a, int b) {
   luaC_barrier(L, uv, ra);
 }
 
+/*
+ * R(A) is known to hold nil, a boolean or a number, no write barrier needed.
+ */
+void vm_OP_SETUPVAL_nb(lua_State *L, LClosure *cl, int a, int b) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  UpVal *uv = cl->upvals[b];
+  setobj(L, uv->v, ra);
+}
+
 void vm_OP_SETTABLE(lua_State *L, TValue *k, int a, int b, int c) {
   TValue *base = L->base;
   TValue *ra = base + a;
   luaV_settable(L, ra, RK(b), RK(c));
 }
 
-void vm_OP_NEWTABLE(lua_State *L, int a, int b_fb2int, int c_fb2int) {
+void vm_OP_SETTABLE_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset) {
+  TValue *base = L->base;
+  luaV_setstr(L, base + a, k + INDEXK(b), RK(c),
+    luaF_keyslot(L, cl->p, pseudo_ops_offset - 1));
+}
+
+/*
+ * R(A)[idx] := RK(C), where 'idx' is the index of the enclosing numeric for loop.
+ */
+void vm_OP_SETTABLE_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  int n;
+  lua_number2int(n, idx);
+  if (vm_likely(ttistable(ra) && luai_numeq(cast_num(n), idx))) {
+    Table *h = hvalue(ra);
+    if (n >= 1 && n <= h->sizearray) {
+      TValue *v = &h->array[n-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_NEWINDEX) == NULL) {
+        TValue *rc = RK(c);
+        setobj2t(L, v, rc);
+        luaC_barriert(L, h, rc);
+        return;
+      }
+    }
+  }
+  luaV_settable(L, ra, RK(b), RK(c));
+}
+
+void vm_OP_SETTABLE_long_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  if (vm_likely(ttistable(ra))) {
+    Table *h = hvalue(ra);
+    if (idx >= 1 && idx <= h->sizearray) {
+      TValue *v = &h->array[idx-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_NEWINDEX) == NULL) {
+        TValue *rc = RK(c);
+        setobj2t(L, v, rc);
+        luaC_barriert(L, h, rc);
+        return;
+      }
+    }
+  }
+  luaV_settable(L, ra, RK(b), RK(c));
+}
+
+/*
+ * RK(C) is known to hold nil, a boolean or a number, no write barrier needed.
+ */
+void vm_OP_SETTABLE_idx_nb(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  int n;
+  lua_number2int(n, idx);
+  if (vm_likely(ttistable(ra) && luai_numeq(cast_num(n), idx))) {
+    Table *h = hvalue(ra);
+    if (n >= 1 && n <= h->sizearray) {
+      TValue *v = &h->array[n-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_NEWINDEX) == NULL) {
+        TValue *rc = RK(c);
+        setobj2t(L, v, rc);
+        return;
+      }
+    }
+  }
+  luaV_settable(L, ra, RK(b), RK(c));
+}
+
+void vm_OP_SETTABLE_long_idx_nb(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  if (vm_likely(ttistable(ra))) {
+    Table *h = hvalue(ra);
+    if (idx >= 1 && idx <= h->sizearray) {
+      TValue *v = &h->array[idx-1];
+      if (!ttisnil(v) || fasttm(L, h->metatable, TM_NEWINDEX) == NULL) {
+        TValue *rc = RK(c);
+        setobj2t(L, v, rc);
+        return;
+      }
+    }
+  }
+  luaV_settable(L, ra, RK(b), RK(c));
+}
+
+/*
+ * The '_nogc' versions of the allocating ops leave the GC check to a later op in the
+ * same basic block.
+ */
+void vm_OP_NEWTABLE_nogc(lua_State *L, LClosure *cl, int a, int b_fb2int, int c_fb2int, int site) {
+  Proto *p = cl->p;
   Table *h;
-  h = luaH_new(L, b_fb2int, c_fb2int);
+  if (p->tsites == NULL) luaF_newtablesites(L, p);
+  h = luaH_newsite(L, (site < p->sizetsites) ? &p->tsites[site] : NULL, b_fb2int, c_fb2int);
   sethvalue(L, L->base + a, h);
+}
+
+void vm_OP_NEWTABLE(lua_State *L, LClosure *cl, int a, int b_fb2int, int c_fb2int, int site) {
+  vm_OP_NEWTABLE_nogc(L, cl, a, b_fb2int, c_fb2int, site);
   luaC_checkGC(L);
 }
 
@@ -121,6 +289,14 @@ void vm_OP_SELF(lua_State *L, TValue *k, int a, int b, int c) {
   luaV_gettable(L, rb, RK(c), ra);
 }
 
+void vm_OP_SELF_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset) {
+  TValue *base = L->base;
+  StkId rb = base + b;
+  setobjs2s(L, base + a + 1, rb);
+  luaV_getstr(L, rb, k + INDEXK(c), base + a,
+    luaF_keyslot(L, cl->p, pseudo_ops_offset - 1));
+}
+
 void vm_OP_ADD(lua_State *L, TValue *k, int a, int b, int c) {
   TValue *base = L->base;
   arith_op(luai_numadd, TM_ADD);
@@ -185,12 +361,12 @@ void vm_OP_UNM(lua_State *L, int a, int b) {
   TValue *base = L->base;
   TValue *ra = base + a;
   TValue *rb = base + b;
-  if (ttisnumber(rb)) {
+  if (vm_likely(ttisnumber(rb))) {
     lua_Number nb = nvalue(rb);
     setnvalue(ra, luai_numunm(nb));
   }
   else {
-    luaV_arith(L, ra, rb, rb, TM_UNM);
+    vm_arith_slow(L, ra, rb, rb, TM_UNM);
   }
 }
 
@@ -215,9 +391,7 @@ void vm_OP_LEN(lua_State *L, int a, int b) {
       break;
     }
     default: {  /* try metamethod */
-      ptrdiff_t br = savestack(L, rb);
-      if (!luaV_call_binTM(L, rb, luaO_nilobject, ra, TM_LEN))
-        luaG_typeerror(L, restorestack(L, br), "get length of");
+      vm_len_slow(L, ra, rb);
     }
   }
 }
@@ -229,6 +403,13 @@ void vm_OP_CONCAT(lua_State *L, int a, int b, int c) {
   setobjs2s(L, base + a, base + b);
 }
 
+void vm_OP_CONCAT_nogc(lua_State *L, int a, int b, int c) {
+  TValue *base;
+  luaV_concat(L, c-b+1, c);
+  base = L->base;
+  setobjs2s(L, base + a, base + b);
+}
+
 void vm_OP_JMP(lua_State *L, int sbx) {
   dojump(sbx);
 }
@@ -325,7 +506,7 @@ void vm_OP_FORPREP(lua_State *L, int a, int sbx) {
   valid &= ttisnumber(init);
   valid &= ttisnumber(plimit);
   valid &= ttisnumber(pstep);
-  if(!valid) {
+  if(vm_unlikely(!valid)) {
     vm_OP_FORPREP_slow(L,a,sbx);
   }
   // subtract pstep from init.
@@ -342,7 +523,7 @@ void vm_OP_FORPREP_no_sub(lua_State *L, int a, int sbx) {
   valid &= ttisnumber(init);
   valid &= ttisnumber(plimit);
   valid &= ttisnumber(pstep);
-  if(!valid) {
+  if(vm_unlikely(!valid)) {
     vm_OP_FORPREP_slow(L,a,sbx);
   }
   dojump(sbx);
@@ -354,7 +535,7 @@ void vm_OP_FORPREP_no_sub(lua_State *L, int a, int sbx) {
 void vm_OP_FORPREP_M_N_N(lua_State *L, int a, int sbx, lua_Number limit, lua_Number step) {
   TValue *ra = L->base + a;
   const TValue *init = ra;
-  if(!ttisnumber(init)) {
+  if(vm_unlikely(!ttisnumber(init))) {
     setnvalue(ra+1, limit);
     setnvalue(ra+2, step);
     vm_OP_FORPREP_slow(L,a,sbx);
@@ -368,7 +549,7 @@ void vm_OP_FORPREP_M_N_N(lua_State *L, int a, int sbx, lua_Number limit, lua_Num
 void vm_OP_FORPREP_N_M_N(lua_State *L, int a, int sbx, lua_Number init, lua_Number step) {
   TValue *ra = L->base + a;
   const TValue *plimit = ra+1;
-  if(!ttisnumber(plimit)) {
+  if(vm_unlikely(!ttisnumber(plimit))) {
     setnvalue(ra, init);
     setnvalue(ra+2, step);
     vm_OP_FORPREP_slow(L,a,sbx);
@@ -451,6 +632,93 @@ int vm_OP_FORLOOP_long_down(lua_State *L, int a, int sbx, lua_Long idx, lua_Long
   return 0;
 }
 
+/*
+ * check if slot 'i' (array slots first, then hash nodes) holds 'key'.
+ */
+static int tfor_pos_is_key(Table *h, int i, const TValue *key) {
+  const TValue *nk;
+  if ((unsigned int)i < (unsigned int)h->sizearray)
+    return ttisnumber(key) && luai_numeq(nvalue(key), cast_num(i+1));
+  i -= h->sizearray;
+  if ((unsigned int)i >= (unsigned int)sizenode(h)) return 0;
+  nk = key2tval(gnode(h, i));
+  if (ttype(nk) != ttype(key)) return 0;
+  if (ttisnumber(key)) return luai_numeq(nvalue(nk), nvalue(key));
+  if (ttisboolean(key)) return bvalue(nk) == bvalue(key);
+  return gcvalue(nk) == gcvalue(key);
+}
+
+/*
+ * Generic for loop.  The standard 'ipairs' and 'next' iterators are run inline
+ * (walk the array part then the hash nodes) instead of being called every step.
+ * 'pos' remembers the slot of the last key returned by 'next', it is only used
+ * after checking that the slot still holds the current key.
+ */
+int vm_OP_TFORLOOP(lua_State *L, int a, int c, int *pos) {
+  TValue *base = L->base;
+  TValue *ra = base + a;
+  StkId cb = ra + 3;  /* call base */
+  lua_CFunction f;
+  Table *h;
+  int i;
+  if (vm_unlikely(!ttisfunction(ra) || !clvalue(ra)->c.isC || !ttistable(ra+1))) {
+    return vm_OP_TFORLOOP_slow(L, a, c);
+  }
+  f = clvalue(ra)->c.f;
+  h = hvalue(ra+1);
+  if (f == luaB_ipairsaux && ttisnumber(ra+2)) {
+    const TValue *v;
+    lua_Integer n;
+    lua_number2integer(n, nvalue(ra+2));
+    i = (int)n;
+    if ((unsigned int)i < (unsigned int)h->sizearray) {
+      v = &h->array[i];
+    } else {
+      v = luaH_getnum(h, i+1);
+    }
+    if (ttisnil(v)) goto loop_end;
+    setnvalue(cb, cast_num(i+1));
+    if (c > 1) setobj2s(L, cb+1, v);
+  } else if (f == luaB_next) {
+    Node *node;
+    if (ttisnil(ra+2)) {
+      i = -1;  /* first iteration */
+    } else if (tfor_pos_is_key(h, *pos, ra+2)) {
+      i = *pos;
+    } else {
+      i = luaH_findindex(L, h, ra+2);
+    }
+    for (i++; i < h->sizearray; i++) {  /* try first array part */
+      if (!ttisnil(&h->array[i])) {
+        setnvalue(cb, cast_num(i+1));
+        if (c > 1) setobj2s(L, cb+1, &h->array[i]);
+        goto loop_next;
+      }
+    }
+    for (; i - h->sizearray < sizenode(h); i++) {  /* then hash part */
+      node = gnode(h, i - h->sizearray);
+      if (!ttisnil(gval(node))) {
+        setobj2s(L, cb, key2tval(node));
+        if (c > 1) setobj2s(L, cb+1, gval(node));
+        goto loop_next;
+      }
+    }
+    goto loop_end;
+loop_next:
+    *pos = i;
+  } else {
+    return vm_OP_TFORLOOP_slow(L, a, c);
+  }
+  /* clear extra loop variables. */
+  for (cb += 2; cb < ra + 3 + c; cb++) setnilvalue(cb);
+  setobjs2s(L, ra+2, ra+3);  /* save control variable */
+  dojump(GETARG_sBx(*L->savedpc));
+  return 1;
+loop_end:
+  for (; cb < ra + 3 + c; cb++) setnilvalue(cb);
+  return 0;
+}
+
 void vm_OP_CLOSE(lua_State *L, int a) {
   luaF_close(L, L->base + a);
 }
@@ -463,6 +731,17 @@ TValue *vm_get_current_constants(LClosure *cl) {
   return cl->p->k;
 }
 
+/*
+ * Code compiled without '-g' only checks for line/count hooks at loop back-edges and
+ * calls.  This is enough to stop a running script from a hook (Ctrl-C, watchdogs),
+ * line hooks only see the lines of those ops and count hooks count the checks.
+ */
+void vm_check_hook(lua_State *L, LClosure *cl, int pc_offset) {
+  if (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) {
+    vm_next_OP(L, cl, pc_offset);
+  }
+}
+
 lua_Number vm_get_number(lua_State *L, int idx) {
   return nvalue(L->base + idx);
 }
@@ -479,6 +758,59 @@ void vm_set_long(lua_State *L, int idx, lua_Long num) {
   setnvalue(L->base + idx, (lua_Number)num);  /* write number to Lua-stack */
 }
 
+/*
+ * Check that register 'a' holds the math library function 'id' and that its
+ * 'nargs' arguments are numbers, then the call can be replaced with inline code.
+ */
+int vm_math_guard(lua_State *L, int a, int nargs, int id) {
+  TValue *ra = L->base + a;
+  int i;
+  if (!ttisfunction(ra) || !clvalue(ra)->c.isC || clvalue(ra)->c.f != llvm_math_funcs[id])
+    return 0;
+  if (L->hookmask & (LUA_MASKCALL | LUA_MASKRET))
+    return 0;  /* hooks must see the call. */
+  for (i = 1; i <= nargs; i++) {
+    if (!ttisnumber(ra + i)) return 0;
+  }
+  return 1;
+}
+
+/*
+ * Scalar replaced tables.  A table from OP_NEWTABLE that is only indexed with constant
+ * keys keeps its fields in local variables of the compiled function.  The GC can't see
+ * those variables, so they only hold values that are not collectable, storing anything
+ * else creates the real table in register 'a' and the table ops are used from then on.
+ */
+void vm_OP_NEWTABLE_scalar(lua_State *L, int a) {
+  setnilvalue(L->base + a);
+}
+
+int vm_scalar_set(lua_State *L, TValue *k, TValue *field, int c) {
+  TValue *base = L->base;
+  TValue *rc = RK(c);
+  if (vm_unlikely(iscollectable(rc))) return 0;
+  setobj(L, field, rc);
+  return 1;
+}
+
+void vm_scalar_get(lua_State *L, TValue *field, int a) {
+  setobj2s(L, L->base + a, field);
+}
+
+void vm_scalar_newtable(lua_State *L, int a, int nfields) {
+  Table *h;
+  h = luaH_new(L, 0, nfields);
+  sethvalue(L, L->base + a, h);
+  luaC_checkGC(L);
+}
+
+void vm_scalar_setfield(lua_State *L, TValue *k, int a, int key, TValue *field) {
+  /* fields are never collectable, no write barrier needed. */
+  if (!ttisnil(field)) {
+    setobj2t(L, luaH_set(L, hvalue(L->base + a), k + key), field);
+  }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,6 +20,34 @@ typedef long lua_Long;
 typedef long long lua_Long;
 #endif
 
+/*
+ * Branch hints and out-of-line slow paths.  The `vm_OP_*' functions are inlined into
+ * every compiled Lua function, their metamethod/error paths are kept in cold functions.
+ */
+#if defined(__GNUC__)
+#define vm_likely(x)	__builtin_expect(!!(x), 1)
+#define vm_unlikely(x)	__builtin_expect(!!(x), 0)
+#else
+#define vm_likely(x)	(x)
+#define vm_unlikely(x)	(x)
+#endif
+
+#if defined(__has_attribute)
+#if __has_attribute(cold)
+#define VM_COLD	__attribute__((noinline, cold))
+#endif
+#endif
+#if !defined(VM_COLD) && defined(__GNUC__) && !defined(__clang__) && \
+	((__GNUC__ * 100 + __GNUC_MINOR__) >= 403)
+#define VM_COLD	__attribute__((noinline, cold))
+#endif
+#if !defined(VM_COLD) && defined(__GNUC__)
+#define VM_COLD	__attribute__((noinline))
+#endif
+#ifndef VM_COLD
+#define VM_COLD
+#endif
+
 typedef unsigned int hint_t;
 #define HINT_NONE							0
 #define HINT_C_NUM_CONSTANT		(1<<0)
@@ -35,6 +63,12 @@ typedef unsigned int hint_t;
 #define HINT_UP								(1<<10)
 #define HINT_DOWN							(1<<11)
 #define HINT_NO_SUB						(1<<12)
+#define HINT_FOR_IDX					(1<<13)
+#define HINT_MATH_CALL				(1<<14)
+#define HINT_SCALAR_TABLE			(1<<15)
+#define HINT_NO_BARRIER				(1<<16)
+#define HINT_NO_GC_CHECK			(1<<17)
+#define HINT_STR_KEY					(1<<18)
 
 typedef enum {
 	VAR_T_VOID = 0,
@@ -59,7 +93,8 @@ typedef enum {
 	VAR_T_CL,
 	VAR_T_OP_VALUE_0,
 	VAR_T_OP_VALUE_1,
-	VAR_T_OP_VALUE_2
+	VAR_T_OP_VALUE_2,
+	VAR_T_OP_VALUE_0_PTR
 } val_t;
 
 typedef struct {
@@ -80,6 +115,8 @@ extern void vm_print_OP(lua_State *L, LClosure *cl, const Instruction i, int pc_
 
 extern void vm_next_OP(lua_State *L, LClosure *cl, int pc_offset);
 
+extern void vm_check_hook(lua_State *L, LClosure *cl, int pc_offset);
+
 extern void vm_OP_MOVE(lua_State *L, int a, int b);
 
 extern void vm_OP_LOADK(lua_State *L, TValue *k, int a, int bx);
@@ -95,16 +132,27 @@ extern void vm_OP_GETUPVAL(lua_State *L, LClosure *cl, int a, int b);
 extern void vm_OP_GETGLOBAL(lua_State *L, TValue *k, LClosure *cl, int a, int bx);
 
 extern void vm_OP_GETTABLE(lua_State *L, TValue *k, int a, int b, int c);
+extern void vm_OP_GETTABLE_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx);
+extern void vm_OP_GETTABLE_long_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx);
+extern void vm_OP_GETTABLE_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset);
 
 extern void vm_OP_SETGLOBAL(lua_State *L, TValue *k, LClosure *cl, int a, int bx);
 
 extern void vm_OP_SETUPVAL(lua_State *L, LClosure *cl, int a, int b);
+extern void vm_OP_SETUPVAL_nb(lua_State *L, LClosure *cl, int a, int b);
 
 extern void vm_OP_SETTABLE(lua_State *L, TValue *k, int a, int b, int c);
+extern void vm_OP_SETTABLE_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx);
+extern void vm_OP_SETTABLE_long_idx(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx);
+extern void vm_OP_SETTABLE_idx_nb(lua_State *L, TValue *k, int a, int b, int c, lua_Number idx);
+extern void vm_OP_SETTABLE_long_idx_nb(lua_State *L, TValue *k, int a, int b, int c, lua_Long idx);
+extern void vm_OP_SETTABLE_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset);
 
-extern void vm_OP_NEWTABLE(lua_State *L, int a, int b, int c);
+extern void vm_OP_NEWTABLE(lua_State *L, LClosure *cl, int a, int b, int c, int site);
+extern void vm_OP_NEWTABLE_nogc(lua_State *L, LClosure *cl, int a, int b, int c, int site);
 
 extern void vm_OP_SELF(lua_State *L, TValue *k, int a, int b, int c);
+extern void vm_OP_SELF_str(lua_State *L, TValue *k, LClosure *cl, int a, int b, int c, int pseudo_ops_offset);
 
 extern void vm_OP_ADD(lua_State *L, TValue *k, int a, int b, int c);
 extern void vm_OP_ADD_NC(lua_State *L, TValue *k, int a, int b, lua_Number nc, int c);
@@ -131,6 +179,7 @@ extern void vm_OP_NOT(lua_State *L, int a, int b);
 extern void vm_OP_LEN(lua_State *L, int a, int b);
 
 extern void vm_OP_CONCAT(lua_State *L, int a, int b, int c);
+extern void vm_OP_CONCAT_nogc(lua_State *L, int a, int b, int c);
 
 extern void vm_OP_JMP(lua_State *L, int sbx);
 
@@ -167,16 +216,25 @@ extern void vm_OP_FORPREP_M_N_N(lua_State *L, int a, int sbx, lua_Number limit,
 extern void vm_OP_FORPREP_N_M_N(lua_State *L, int a, int sbx, lua_Number init, lua_Number step);
 extern void vm_OP_FORPREP_N_N_N(lua_State *L, int a, int sbx, lua_Number init, lua_Number step);
 
-extern int vm_OP_TFORLOOP(lua_State *L, int a, int c);
+extern int vm_OP_TFORLOOP(lua_State *L, int a, int c, int *pos);
+extern int vm_OP_TFORLOOP_slow(lua_State *L, int a, int c);
+
+/* standard iterators from lbaselib.c, TFORLOOP runs them inline. */
+LUAI_FUNC int luaB_next (lua_State *L);
+LUAI_FUNC int luaB_ipairsaux (lua_State *L);
 
 extern void vm_OP_SETLIST(lua_State *L, int a, int b, int c);
 
 extern void vm_OP_CLOSE(lua_State *L, int a);
 
 extern void vm_OP_CLOSURE(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_offset);
+extern void vm_OP_CLOSURE_nogc(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_offset);
 
 extern void vm_OP_VARARG(lua_State *L, LClosure *cl, int a, int b);
 
+extern VM_COLD void vm_arith_slow(lua_State *L, TValue *ra, const TValue *rb, const TValue *rc, int op);
+extern VM_COLD void vm_len_slow(lua_State *L, TValue *ra, const TValue *rb);
+
 extern int is_mini_vm_op(int opcode);
 extern void vm_mini_vm(lua_State *L, LClosure *cl, int count, int pseudo_ops_offset);
 
@@ -192,6 +250,14 @@ extern void vm_set_number(lua_State *L, int idx, lua_Number num);
 extern lua_Long vm_get_long(lua_State *L, int idx);
 extern void vm_set_long(lua_State *L, int idx, lua_Long num);
 
+extern int vm_math_guard(lua_State *L, int a, int nargs, int id);
+
+extern void vm_OP_NEWTABLE_scalar(lua_State *L, int a);
+extern int vm_scalar_set(lua_State *L, TValue *k, TValue *field, int c);
+extern void vm_scalar_get(lua_State *L, TValue *field, int a);
+extern void vm_scalar_newtable(lua_State *L, int a, int nfields);
+extern void vm_scalar_setfield(lua_State *L, TValue *k, int a, int key, TValue *field);
+
 /*
 ** some macros for common tasks in `vm_OP_*' functions.
 */
@@ -220,23 +286,23 @@ extern void vm_set_long(lua_State *L, int idx, lua_Long num);
         TValue *ra = base + a; \
         TValue *rb = RK(b); \
         TValue *rc = RK(c); \
-        if (ttisnumber(rb) && ttisnumber(rc)) { \
+        if (vm_likely(ttisnumber(rb) && ttisnumber(rc))) { \
           lua_Number nb = nvalue(rb), nc = nvalue(rc); \
           setnvalue(ra, op(nb, nc)); \
         } \
         else \
-          luaV_arith(L, ra, rb, rc, tm); \
+          vm_arith_slow(L, ra, rb, rc, tm); \
       }
 
 #define arith_op_nc(op,tm) { \
         TValue *ra = base + a; \
         TValue *rb = RK(b); \
-        if (ttisnumber(rb)) { \
+        if (vm_likely(ttisnumber(rb))) { \
           lua_Number nb = nvalue(rb); \
           setnvalue(ra, op(nb, nc)); \
         } \
         else \
-          luaV_arith(L, ra, rb, RK(c), tm); \
+          vm_arith_slow(L, ra, rb, RK(c), tm); \
       }
 
 
@@ -56,21 +56,57 @@ const vm_func_info vm_op_functions[] = {
   { OP_GETTABLE, HINT_NONE, VAR_T_VOID, "vm_OP_GETTABLE",
     {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
   },
+  { OP_GETTABLE, HINT_FOR_IDX, VAR_T_VOID, "vm_OP_GETTABLE_idx",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_GETTABLE, HINT_FOR_IDX | HINT_USE_LONG, VAR_T_VOID, "vm_OP_GETTABLE_long_idx",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_GETTABLE, HINT_STR_KEY, VAR_T_VOID, "vm_OP_GETTABLE_str",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_PC_OFFSET, VAR_T_VOID},
+  },
   { OP_SETGLOBAL, HINT_NONE, VAR_T_VOID, "vm_OP_SETGLOBAL",
     {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_Bx, VAR_T_VOID},
   },
   { OP_SETUPVAL, HINT_NONE, VAR_T_VOID, "vm_OP_SETUPVAL",
     {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_VOID},
   },
+  { OP_SETUPVAL, HINT_NO_BARRIER, VAR_T_VOID, "vm_OP_SETUPVAL_nb",
+    {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_VOID},
+  },
   { OP_SETTABLE, HINT_NONE, VAR_T_VOID, "vm_OP_SETTABLE",
     {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
   },
+  { OP_SETTABLE, HINT_FOR_IDX, VAR_T_VOID, "vm_OP_SETTABLE_idx",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_SETTABLE, HINT_FOR_IDX | HINT_USE_LONG, VAR_T_VOID, "vm_OP_SETTABLE_long_idx",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_SETTABLE, HINT_FOR_IDX | HINT_NO_BARRIER, VAR_T_VOID, "vm_OP_SETTABLE_idx_nb",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_SETTABLE, HINT_FOR_IDX | HINT_USE_LONG | HINT_NO_BARRIER, VAR_T_VOID, "vm_OP_SETTABLE_long_idx_nb",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_SETTABLE, HINT_STR_KEY, VAR_T_VOID, "vm_OP_SETTABLE_str",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_PC_OFFSET, VAR_T_VOID},
+  },
   { OP_NEWTABLE, HINT_NONE, VAR_T_VOID, "vm_OP_NEWTABLE",
-    {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_B_FB2INT, VAR_T_ARG_C_FB2INT, VAR_T_VOID},
+    {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B_FB2INT, VAR_T_ARG_C_FB2INT, VAR_T_OP_VALUE_0, VAR_T_VOID},
+  },
+  { OP_NEWTABLE, HINT_SCALAR_TABLE, VAR_T_VOID, "vm_OP_NEWTABLE_scalar",
+    {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_VOID},
+  },
+  { OP_NEWTABLE, HINT_NO_GC_CHECK, VAR_T_VOID, "vm_OP_NEWTABLE_nogc",
+    {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B_FB2INT, VAR_T_ARG_C_FB2INT, VAR_T_OP_VALUE_0, VAR_T_VOID},
   },
   { OP_SELF, HINT_NONE, VAR_T_VOID, "vm_OP_SELF",
     {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
   },
+  { OP_SELF, HINT_STR_KEY, VAR_T_VOID, "vm_OP_SELF_str",
+    {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_PC_OFFSET, VAR_T_VOID},
+  },
   { OP_ADD, HINT_NONE, VAR_T_VOID, "vm_OP_ADD",
     {VAR_T_LUA_STATE_PTR, VAR_T_K, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
   },
@@ -119,6 +155,9 @@ const vm_func_info vm_op_functions[] = {
   { OP_CONCAT, HINT_NONE, VAR_T_VOID, "vm_OP_CONCAT",
     {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
   },
+  { OP_CONCAT, HINT_NO_GC_CHECK, VAR_T_VOID, "vm_OP_CONCAT_nogc",
+    {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C, VAR_T_VOID},
+  },
   { OP_JMP, HINT_NONE, VAR_T_VOID, "vm_OP_JMP",
     {VAR_T_LUA_STATE_PTR, VAR_T_ARG_sBx, VAR_T_VOID},
   },
@@ -189,7 +228,7 @@ const vm_func_info vm_op_functions[] = {
     {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_sBx, VAR_T_OP_VALUE_0, VAR_T_OP_VALUE_2, VAR_T_VOID},
   },
   { OP_TFORLOOP, HINT_NONE, VAR_T_INT, "vm_OP_TFORLOOP",
-    {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_C, VAR_T_VOID},
+    {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_C, VAR_T_OP_VALUE_0_PTR, VAR_T_VOID},
   },
   { OP_SETLIST, HINT_NONE, VAR_T_VOID, "vm_OP_SETLIST",
     {VAR_T_LUA_STATE_PTR, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_ARG_C_NEXT_INSTRUCTION, VAR_T_VOID},
@@ -200,6 +239,9 @@ const vm_func_info vm_op_functions[] = {
   { OP_CLOSURE, HINT_NONE, VAR_T_VOID, "vm_OP_CLOSURE",
     {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_Bx, VAR_T_PC_OFFSET, VAR_T_VOID},
   },
+  { OP_CLOSURE, HINT_NO_GC_CHECK, VAR_T_VOID, "vm_OP_CLOSURE_nogc",
+    {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_Bx, VAR_T_PC_OFFSET, VAR_T_VOID},
+  },
   { OP_VARARG, HINT_NONE, VAR_T_VOID, "vm_OP_VARARG",
     {VAR_T_LUA_STATE_PTR, VAR_T_CL, VAR_T_ARG_A, VAR_T_ARG_B, VAR_T_VOID},
   },
@@ -360,7 +402,7 @@ void vm_OP_FORPREP_slow(lua_State *L, int a, int sbx) {
     luaG_runerror(L, LUA_QL("for") " step must be a number");
 }
 
-int vm_OP_TFORLOOP(lua_State *L, int a, int c) {
+int vm_OP_TFORLOOP_slow(lua_State *L, int a, int c) {
   TValue *base = L->base;
   TValue *ra = base + a;
   StkId cb = ra + 3;  /* call base */
@@ -382,27 +424,17 @@ int vm_OP_TFORLOOP(lua_State *L, int a, int c) {
 void vm_OP_SETLIST(lua_State *L, int a, int b, int c) {
   TValue *base = L->base;
   TValue *ra = base + a;
-  int last;
-  Table *h;
   fixedstack(L);
   if (b == 0) {
     b = cast_int(L->top - ra) - 1;
     L->top = L->ci->top;
   }
   runtime_check(L, ttistable(ra));
-  h = hvalue(ra);
-  last = ((c-1)*LFIELDS_PER_FLUSH) + b;
-  if (last > h->sizearray)  /* needs more space? */
-    luaH_resizearray(L, h, last);  /* pre-alloc it at once */
-  for (; b > 0; b--) {
-    TValue *val = ra+b;
-    setobj2t(L, luaH_setnum(L, h, last--), val);
-    luaC_barriert(L, h, val);
-  }
+  luaH_setlist(L, hvalue(ra), (c-1)*LFIELDS_PER_FLUSH + 1, ra+1, b);
   unfixedstack(L);
 }
 
-void vm_OP_CLOSURE(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_offset) {
+void vm_OP_CLOSURE_nogc(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_offset) {
   TValue *base = L->base;
   const Instruction *pc;
   TValue *ra = base + a;
@@ -426,6 +458,10 @@ void vm_OP_CLOSURE(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_off
     }
   }
   unfixedstack(L);
+}
+
+void vm_OP_CLOSURE(lua_State *L, LClosure *cl, int a, int bx, int pseudo_ops_offset) {
+  vm_OP_CLOSURE_nogc(L, cl, a, bx, pseudo_ops_offset);
   luaC_checkGC(L);
 }
 
@@ -646,7 +682,13 @@ void vm_mini_vm(lua_State *L, LClosure *cl, int count, int pseudo_ops_offset) {
         continue;
       }
       case OP_SETTABLE: {
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
+        TValue *rb = RKB(i);
+        if (ISK(GETARG_B(i)) && ttisstring(rb)) {
+          Protect(luaV_setstr(L, ra, rb, RKC(i),
+                              luaF_keyslot(L, cl->p, pcRel(pc, cl->p))));
+        }
+        else
+          Protect(luaV_settable(L, ra, rb, RKC(i)));
         continue;
       }
       default: {
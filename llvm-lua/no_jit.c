@@ -53,7 +53,7 @@ void llvm_compiler_compile(lua_State *L, Proto *p) {UNUSED(L);UNUSED(p);}
 void llvm_compiler_compile_all(lua_State *L, Proto *p) {UNUSED(L);UNUSED(p);}
 void llvm_compiler_free(lua_State *L, Proto *p) {UNUSED(L);UNUSED(p);}
 
-void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping) {UNUSED(L);UNUSED(p);UNUSED(output);UNUSED(stripping);}
+void llvm_dumper_dump(const char *output, lua_State *L, Proto *p, int stripping, int link_requires) {UNUSED(L);UNUSED(p);UNUSED(output);UNUSED(stripping);UNUSED(link_requires);}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,61 @@
+
+-- builtins with precall fast paths must behave like the plain C functions.
+local function check(a, b)
+	assert(a == b, tostring(a) .. " ~= " .. tostring(b))
+end
+
+check(type(1), "number")
+check(type(nil), "nil")
+check(type({}), "table")
+check(select('#'), 0)
+check(select('#', 1, nil, nil), 3)
+check(select(2, "a", "b", "c"), "b")
+check(select(-1, "a", "b", "c"), "c")
+check(select('#', select(2, 1, 2, 3)), 2)
+assert(not pcall(select, 0, 1))
+
+local t = setmetatable({}, {__index = function() return "meta" end})
+check(rawget(t, 1), nil)
+check(t[1], "meta")
+check(rawset(t, 1, "raw"), t)
+check(rawget(t, 1), "raw")
+assert(not pcall(rawset, t, nil, 1))
+assert(not pcall(rawget, t))
+
+check(tostring(10), "10")
+check(tostring(1.5), "1.5")
+check(tonumber(12), 12)
+check(tonumber("0x10"), 16)
+check(tonumber("z"), nil)
+check(tonumber("ff", 16), 255)
+
+local s = "hello"
+check(s:len(), 5)
+check(s:sub(2), "ello")
+check(s:sub(2, -2), "ell")
+check(s:sub(-3), "llo")
+check(s:sub(1), s)
+check(s:sub(4, 2), "")
+check(s:byte(), 104)
+check(select('#', s:byte(1, -1)), 5)
+check(select('#', s:byte(10)), 0)
+check(s:byte(-1), 111)
+check(string.char(), "")
+check(string.char(104, 105), "hi")
+assert(not pcall(string.char, 256))
+assert(not pcall(string.len))
+
+local a = {}
+for i=1,10 do table.insert(a, i) end
+check(#a, 10)
+table.insert(a, 1, 0)
+check(a[1], 0)
+check(a[11], 10)
+
+-- extra results are nil.
+local x, y = math.sin(0), nil
+local p, q = type(1)
+check(q, nil)
+assert(not pcall(math.sin))
+
+print("ok")
@@ -0,0 +1,65 @@
+
+-- numeric for loops indexing arrays with the loop variable.
+local N = 100
+local a, b, d = {}, {}, {}
+for i=1,N do
+	b[i] = i
+	d[i] = N - i
+end
+for i=1,N do
+	a[i] = b[i] * 2 + d[i]
+end
+for i=1,N do
+	assert(a[i] == N + i)
+end
+
+-- index past the array part and holes with metamethods.
+local seen = 0
+local t = setmetatable({1,2,3}, {
+	__index = function(t, k) return -k end,
+	__newindex = function(t, k, v) seen = seen + 1; rawset(t, k, v) end,
+})
+t[2] = nil
+local sum = 0
+for i=1,6 do
+	sum = sum + t[i]
+end
+assert(sum == 1 - 2 + 3 - 4 - 5 - 6)
+for i=1,6 do
+	t[i] = i
+end
+assert(seen == 4)
+
+-- fractional steps must not hit the array part.
+local f = {}
+for i=1,3,0.5 do
+	f[i] = i
+end
+assert(f[1.5] == 1.5 and f[2] == 2 and #f == 3)
+
+-- loop variable reassigned in the body.
+local r = {}
+for i=1,5 do
+	i = i * 2
+	r[i] = true
+end
+assert(r[10] and not r[1])
+
+-- loop variable changed through an upvalue of a closure.
+local u = {}
+for i=1,3 do
+	local f = function() i = i + 10 end
+	f()
+	u[i] = true
+end
+assert(u[11] and u[12] and u[13] and not u[1] and #u == 0)
+local v = {}
+for i=1,3 do
+	local set = function(x) i = x end
+	v[i] = i
+	set(i + 20)
+	v[i] = (v[i] or 0) + 1
+end
+assert(v[1] == 1 and v[21] == 1 and v[23] == 1)
+
+print("ok")
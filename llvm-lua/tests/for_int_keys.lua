@@ -0,0 +1,52 @@
+
+-- table keys computed from the loop variable of an integer for loop.
+local N = 50
+local t = {}
+for i=1,N*2+1 do t[i] = 0 end
+for i=1,N do
+	t[i*2] = i
+	t[i*2+1] = -i
+end
+for i=1,N do
+	assert(t[i*2] == i and t[2*i+1] == -i)
+	assert(t[i-1+1] == t[i])
+	local j = N - i
+	assert(t[(j + 1) * 2] == N - i + 1)
+end
+
+-- keys outside the array part, zero and negative keys.
+local h = {}
+for i=-5,5 do
+	h[i*3 - 1] = i
+end
+for i=-5,5 do
+	assert(h[3*i - 1] == i)
+end
+assert(h[-16] == -5 and h[14] == 5 and h[0] == nil)
+
+-- keys too large to be exact doubles are left to the generic ops.
+local big = {}
+for i=1,3 do
+	big[i * 4503599627370496] = i
+end
+assert(big[4503599627370496 * 2] == 2)
+
+-- loop variable or key changed through an upvalue of a closure.
+local u = {}
+for i=1,3 do
+	local bump = function() i = i + 10 end
+	bump()
+	u[i*2] = i
+end
+assert(u[22] == 11 and u[24] == 12 and u[26] == 13 and u[2] == nil)
+local k
+local setk = function(v) k = v end
+local w = {}
+for i=1,3 do
+	k = i*2 + 1
+	setk(-i)
+	w[k] = i
+end
+assert(w[-1] == 1 and w[-3] == 3 and w[3] == nil)
+
+print("ok")
@@ -0,0 +1,44 @@
+
+-- stores into tables and upvalues while the GC is running.
+collectgarbage("setpause", 100)
+collectgarbage("setstepmul", 1000)
+local N = 2000
+local t = {}
+for i=1,N do t[i] = false end
+local up = 0
+local function setup(v) up = v end
+for i=1,N do
+	t[i] = i
+	local y = i * 2
+	t[i] = y
+	t[i] = true
+	t[i] = {i}
+	if i % 100 == 0 then collectgarbage("step") end
+end
+for i=1,N do assert(t[i][1] == i) end
+
+-- a closure can change a captured loop register.
+local keep = {}
+for i=1,N do
+	local v = i
+	local f = function() v = {i} end
+	f()
+	t[i] = v
+	keep[i] = f
+	if i % 100 == 0 then collectgarbage("step") end
+end
+collectgarbage()
+for i=1,N do assert(t[i][1] == i) end
+
+for i=1,N do
+	setup(i)
+	setup({i})
+	local s = "a" .. i
+	local s2 = s .. "b"
+	local s3 = s2 .. "c"
+	t[i] = {s, s2, s3, {}, function() return up end}
+end
+collectgarbage()
+assert(up[1] == N and t[N][3] == "a" .. N .. "bc")
+
+print("ok")
@@ -0,0 +1,52 @@
+-- objects freed by the background free thread must not be touched again
+local prev = collectgarbage("bgfree", 1)
+if prev == nil then
+	print("bgfree not available")
+	return
+end
+assert(prev == false)
+
+local N = 20000
+local keep = {}
+for round=1,5 do
+	local t = {}
+	for i=1,N do
+		t[i] = { i, tostring(i) .. "x", function() return i end }
+		if i % 100 == 0 then keep[#keep + 1] = t[i] end
+	end
+	t = nil
+	collectgarbage("step", 100)
+end
+collectgarbage()
+
+for _,v in ipairs(keep) do
+	assert(v[2] == tostring(v[1]) .. "x" and v[3]() == v[1])
+end
+
+-- dead coroutines
+for i=1,1000 do
+	local co = coroutine.wrap(function(a) local b = coroutine.yield(a + 1) return b * 2 end)
+	assert(co(i) == i + 1)
+	assert(co(i) == i * 2)
+end
+
+-- memory limit still works while blocks are freed in the background
+local limit = collectgarbage("getmemlimit")
+collectgarbage("setmemlimit", collectgarbage("count") + 2048)
+for i=1,50000 do
+	local t = { string.rep("y", 100) .. i }
+end
+collectgarbage("setmemlimit", limit)
+
+-- generational mode
+collectgarbage("generational")
+for i=1,100000 do
+	local t = { i }
+	keep[#keep + 1] = (i % 1000 == 0) and t or nil
+end
+collectgarbage("incremental")
+
+assert(collectgarbage("bgfree", 0) == true)
+assert(collectgarbage("bgfree", 0) == false)
+collectgarbage()
+print("done")
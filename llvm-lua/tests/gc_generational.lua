@@ -0,0 +1,82 @@
+
+-- generational GC mode: young objects referenced from old ones must survive
+-- minor collections, garbage must still be collected.
+assert(collectgarbage("generational", 5) == "incremental")
+assert(collectgarbage("generational") == "generational")
+
+local old = {}
+for i=1,1000 do old[i] = {i} end
+collectgarbage()  -- major collection, 'old' and its tables are old now.
+
+local N = 20000
+for i=1,N do
+	-- young objects stored into old tables (back barrier).
+	old[i % 1000 + 1] = {i}
+	-- short lived garbage.
+	local t = {i, tostring(i), function() return i end}
+end
+for i=1,1000 do assert(type(old[i][1]) == "number") end
+
+-- old closure with an upvalue that gets young values (forward barrier).
+local up
+local function set(v) up = v end
+collectgarbage()
+for i=1,N do
+	set({i})
+	local x = {}
+end
+assert(up[1] == N)
+
+-- weak tables keep only live young keys/values.
+local weak = setmetatable({}, {__mode = "k"})
+local keep = {}
+collectgarbage()
+for i=1,100 do
+	local k = {}
+	weak[k] = i
+	if i % 2 == 0 then keep[#keep + 1] = k end
+end
+for i=1,N do local x = {i} end
+collectgarbage("step")
+local n = 0
+for k, v in pairs(weak) do n = n + 1 end
+assert(n >= 50)
+collectgarbage()
+n = 0
+for k, v in pairs(weak) do n = n + 1 end
+assert(n == 50)
+
+-- finalizers of young userdata run.
+local finalized = 0
+local proto = newproxy(true)
+getmetatable(proto).__gc = function() finalized = finalized + 1 end
+for i=1,100 do local u = newproxy(proto) end
+proto = nil
+collectgarbage("step")
+collectgarbage()
+assert(finalized == 101)
+
+-- coroutines keep their young stack values.
+local co = coroutine.wrap(function()
+	local t = {}
+	for i=1,N do
+		t[i % 100 + 1] = {i}
+		if i % 1000 == 0 then coroutine.yield() end
+	end
+	return t
+end)
+collectgarbage()
+for i=1,N/1000 do co(); local x = {} end
+local t = co()
+for i=1,100 do assert(type(t[i][1]) == "number") end
+
+-- garbage is reclaimed and switching back works.
+local before = collectgarbage("count")
+for i=1,N do local x = {i, {}} end
+collectgarbage("step")
+assert(collectgarbage("count") < before + 1024)
+assert(collectgarbage("incremental") == "generational")
+collectgarbage()
+for i=1,1000 do assert(old[i][1] % 1000 == i - 1 or old[i][1] == i) end
+
+print("ok")
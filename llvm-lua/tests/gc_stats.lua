@@ -0,0 +1,50 @@
+-- collector timing histograms
+local stats = collectgarbage("stats")
+if stats == nil then
+	print("gc stats not available")
+	return
+end
+
+local function churn(n)
+	for i=1,n do
+		local t = { i, tostring(i) }
+	end
+end
+
+local function check(stats)
+	for _,kind in ipairs{"propagate", "atomic", "sweepstring", "sweep", "finalize", "step", "fullgc"} do
+		local t = stats[kind]
+		local n = 0
+		for _,c in ipairs(t.hist) do n = n + c end
+		assert(n == t.count, kind)
+		assert(t.total >= 0 and t.max >= 0 and t.max <= t.total + 1e-9, kind)
+	end
+end
+
+collectgarbage("stats", 1)  -- reset
+churn(200000)
+collectgarbage()
+stats = collectgarbage("stats")
+check(stats)
+assert(stats.step.count > 0 and stats.fullgc.count == 1)
+assert(stats.atomic.count > 0 and stats.sweep.count > 0)
+
+-- memory limit forces collections
+local limit = collectgarbage("getmemlimit")
+collectgarbage("setmemlimit", collectgarbage("count") + 100)
+for i=1,1000 do
+	local s = string.rep("x", 20000) .. i
+end
+collectgarbage("setmemlimit", limit)
+stats = collectgarbage("stats", 1)
+check(stats)
+assert(stats.limit > 0)
+
+-- generational mode
+collectgarbage("generational")
+churn(200000)
+collectgarbage("incremental")
+stats = collectgarbage("stats")
+check(stats)
+assert(stats.step.count > 0 and stats.atomic.count > 0)
+print("done")
@@ -0,0 +1,73 @@
+-- time-bounded collector steps, big tables are traversed in chunks
+assert(collectgarbage("setsteptime", 1) == 0)
+
+-- tables resized while they are traversed
+for k=1,40 do
+	local t = loadstring("return {}")()  -- new site, so `t' is not presized
+	for i=1,2048 do t[i] = { i } end
+	collectgarbage()
+	for s=1,k do collectgarbage("step", 0) end
+	for i=2049,5000 do t[i] = i end  -- resize, maybe while `t' is half traversed
+	for i=2049,5000 do t[i] = { i } end
+	collectgarbage()
+	for i=1,5000 do assert(t[i][1] == i) end
+end
+
+-- new keys move colliding entries into free nodes the traversal already passed
+collectgarbage("setsteptime", 1000000)
+for seed=1,10 do
+	math.randomseed(seed)
+	local t = {}
+	for i=1,1500 do t["k" .. i] = { i } end  -- 2048 nodes
+	collectgarbage()
+	for r=1,200 do
+		collectgarbage("step", 0)
+		for j=1,5 do
+			local f = math.random() * 1e6 + 0.5
+			t[f] = f
+		end
+	end
+	collectgarbage()
+	for i=1,1500 do
+		local v = t["k" .. i]
+		assert(type(v) == "table" and v[1] == i, "lost value k" .. i)
+	end
+end
+
+collectgarbage("setsteptime", 50)
+
+local N = 50000
+local big = {}
+for i=1,N do big[i] = { i } end
+local hash = {}
+for i=1,N do hash["k" .. i] = { i } end
+
+-- replace entries while the collector is traversing the tables
+for round=1,20 do
+	for i=1,N,7 do
+		big[i] = { i }
+		hash["k" .. i] = { i }
+	end
+	-- grow both tables, moving their entries
+	for i=1,1000 do
+		big[#big + 1] = { #big + 1 }
+		hash["n" .. round .. "_" .. i] = { round * 1000 + i }
+	end
+	collectgarbage("step", 0)
+end
+collectgarbage()
+
+for i=1,#big do assert(big[i][1] == i) end
+for i=1,N do assert(hash["k" .. i][1] == i) end
+for round=1,20 do
+	for i=1,1000 do assert(hash["n" .. round .. "_" .. i][1] == round * 1000 + i) end
+end
+
+-- weak tables are not chunked
+local weak = setmetatable({}, { __mode = "v" })
+for i=1,5000 do weak[i] = big[i] end
+collectgarbage()
+for i=1,5000 do assert(weak[i] == big[i]) end
+
+assert(collectgarbage("setsteptime", 0) == 50)
+print("done")
@@ -0,0 +1,70 @@
+-- the string table is resized incrementally, strings must stay interned
+-- while they live in either bucket array
+local function fill(n, tag)
+	local list, keys = {}, {}
+	for i=1,n do
+		local s = tag .. i
+		list[i] = s
+		keys[s] = i
+		if i % 1000 == 0 then collectgarbage("step", 0) end
+	end
+	return list, keys
+end
+
+local function check(list, keys, tag)
+	for i=1,#list do
+		local s = tag .. i
+		assert(list[i] == s)
+		assert(keys[s] == i)
+	end
+end
+
+for round=1,3 do
+	-- grow: every doubling starts a new resize
+	local list, keys = fill(100000, "s" .. round .. "_")
+	check(list, keys, "s" .. round .. "_")
+	-- shrink: drop most strings, the sweep halves the table
+	for i=1,#list do
+		if i % 16 ~= 0 then keys[list[i]] = nil; list[i] = false end
+	end
+	collectgarbage()
+	local tag = "s" .. round .. "_"
+	for i=1,4000 do
+		local s = tag .. i  -- found again while the table is shrinking
+		if i % 16 == 0 then assert(keys[s] == i and list[i] == s) end
+		collectgarbage("step", 0)
+	end
+	list, keys = nil, nil
+	collectgarbage()
+	collectgarbage()
+end
+
+-- same in generational mode
+collectgarbage("generational")
+local list, keys = fill(50000, "g")
+check(list, keys, "g")
+list, keys = nil, nil
+collectgarbage()
+list, keys = fill(20000, "h")
+check(list, keys, "h")
+collectgarbage("incremental")
+
+-- long keys inserted & removed while the collector steps, the buffer and
+-- string table shrinks at the end of a sweep keep the estimate in bounds
+math.randomseed(1)
+local t, live = {}, {}
+for round=1,20000 do
+	local k = string.rep(string.char(97 + math.random(0, 25)), 41 + math.random(0, 60)) ..
+		math.random(1, 500)
+	if math.random() < 0.5 then
+		t[k] = round
+		live[#live + 1] = k
+	elseif #live > 0 then
+		t[table.remove(live, math.random(#live))] = nil
+	end
+	if round % 1000 == 0 then collectgarbage("step", math.random(1, 50)) end
+end
+t, live = nil, nil
+collectgarbage()
+
+print("ok")
@@ -0,0 +1,19 @@
+
+-- a count hook must be able to stop loops without calls.
+local function stop_after(n, f)
+	local count = 0
+	debug.sethook(function()
+		count = count + 1
+		if count == n then error("stopped") end
+	end, "", 1)
+	local ok, err = pcall(f)
+	debug.sethook()
+	assert(not ok and string.find(err, "stopped"), err)
+end
+
+stop_after(10, function() while true do end end)
+stop_after(10, function() local i = 0 repeat i = i + 1 until i < 0 end)
+stop_after(10, function() for i=1,1e300 do end end)
+stop_after(10, function() for k in next, {1}, nil do end while true do end end)
+
+print("ok")
@@ -0,0 +1,5 @@
+-- module for require_link.lua, counts how often its chunk runs
+link_module_loads = (link_module_loads or 0) + 1
+local M = {}
+function M.twice(x) return x * 2 end
+return M
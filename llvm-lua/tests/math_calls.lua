@@ -0,0 +1,25 @@
+
+-- calls to math functions compiled inline, guarded by the function identity.
+local sqrt, floor = math.sqrt, math.floor
+local sum = 0
+for i=1,100 do
+	sum = sum + sqrt(i * i) + math.floor(i / 3) + math.abs(-i) + math.pow(2, 2)
+end
+assert(sum == 5050 + 1650 + 5050 + 400)
+assert(math.deg(math.rad(90)) == 90)
+assert(math.sqrt(-1) ~= math.sqrt(-1))
+assert(math.fmod(7, 3) == 1)
+
+-- replaced functions must be called.
+local orig = math.floor
+math.floor = function(x) return "floor" end
+assert(math.floor(1.5) == "floor")
+math.floor = orig
+floor = function(x) return "local" end
+assert(floor(1.5) == "local")
+
+-- non-number arguments take the normal call.
+assert(math.sqrt("4") == 2)
+assert(not pcall(function() return math.sin({}) end))
+
+print("ok")
@@ -0,0 +1,44 @@
+-- allocation heavy code, runs on the pool allocator of luaL_newpoolstate
+-- when the core is built with LUA_USE_POOLALLOC.
+local function churn(n)
+	local keep = {}
+	for i=1,n do
+		-- small blocks of many size classes, reallocs across classes & large blocks
+		local t = {}
+		for j=1,i % 40 do t[j] = j end
+		t.s = string.rep("x", i % 300) .. i
+		t.f = function() return i end
+		if i % 100 == 0 then
+			t.big = string.rep("y", 4096 + i)
+		end
+		keep[i % 64 + 1] = t
+	end
+	for i=1,64 do
+		local t = keep[i]
+		if t then assert(t.f() % 64 + 1 == i and #t == t.f() % 40) end
+	end
+end
+
+churn(20000)
+collectgarbage()
+churn(20000)
+
+-- same code under a memory limit, garbage is collected to stay below it
+local limit = collectgarbage("getmemlimit")
+collectgarbage()
+collectgarbage("setmemlimit", collectgarbage("count") + 1024)
+churn(20000)
+
+-- growing past the limit fails, the state is usable after that
+local hold = {}
+local ok, err = pcall(function()
+	for i=1,100000 do hold[i] = string.rep("z", 100) .. i end
+end)
+assert(not ok and err == "not enough memory")
+hold = nil
+collectgarbage()
+churn(2000)
+collectgarbage("setmemlimit", limit)
+churn(2000)
+
+print("ok")
@@ -0,0 +1,44 @@
+-- several string fields per object, same shape & mixed shapes.
+-- time it with a larger count: lua record_fields.lua 20000
+local n = tonumber((arg and arg[1]) or 100)
+
+local N = 200
+local objs = {}
+for i=1,N do
+	objs[i] = {x=i, y=i*2, z=i*3, vx=1, vy=2, vz=3, mass=1.5, name="p"..i}
+end
+for iter=1,n do
+	for i=1,N do
+		local o = objs[i]
+		o.x = o.x + o.vx * o.mass
+		o.y = o.y + o.vy * o.mass
+		o.z = o.z + o.vz * o.mass
+	end
+end
+for i=1,N do
+	local o = objs[i]
+	assert(o.x == i + n * 1.5 and o.y == i*2 + n * 3 and o.z == i*3 + n * 4.5)
+	assert(o.name == "p"..i)
+end
+
+-- keys sit in different nodes from one table to the next
+local mixed = {}
+for i=1,300 do
+	local o = {id=i, w=i%7, h=i%11, name="n"..i, tag=i%3}
+	if i % 2 == 0 then o.extra = i end
+	if i % 3 == 0 then o.more = i; o.other = 1 end
+	mixed[i] = o
+end
+local s, s1 = 0, 0
+for i=1,300 do
+	s1 = s1 + i + (i%7) * (i%11) + i%3
+end
+for iter=1,n do
+	for i=1,300 do
+		local o = mixed[i]
+		s = s + o.id + o.w * o.h + o.tag
+	end
+end
+assert(s == s1 * n)
+
+print("ok")
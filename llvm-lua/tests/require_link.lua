@@ -0,0 +1,18 @@
+-- constant 'require' names are preloaded by 'lua-compiler -link-requires',
+-- run it from the llvm-lua directory: the standard libraries and modules
+-- loaded twice must behave as with the runtime 'require'
+local os_lib = require "os"
+local string_lib = require "string"
+assert(os_lib == os and string_lib == string)
+
+local m = require "tests.link_module"
+assert(m.twice(21) == 42 and link_module_loads == 1)
+assert(require "tests.link_module" == m)
+assert(package.loaded["tests.link_module"] == m)
+
+-- names that are not constants are still resolved at runtime
+local name = "tests." .. "link_module"
+assert(require(name) == m)
+assert(link_module_loads == 1)  -- one run of the module chunk
+
+print("ok")
@@ -0,0 +1,53 @@
+
+-- record tables that never leave the function.
+local function area(w, h)
+	local p = {x=w, y=h}
+	return p.x * p.y
+end
+assert(area(3, 4) == 12)
+
+local function sum(n)
+	local s = 0
+	for i=1,n do
+		local v = {x=i, y=i * 2}
+		v.z = v.x + v.y
+		s = s + v.z
+	end
+	return s
+end
+assert(sum(10) == 165)
+
+-- missing fields are nil.
+local function missing(a)
+	local p = {x=a}
+	return p.y
+end
+assert(missing(1) == nil)
+
+-- collectable values stored into the table.
+local function named(a, name)
+	local p = {x=a}
+	p.name = name
+	p.x = p.x + 1
+	collectgarbage()
+	return p.name .. p.x
+end
+assert(named(1, "p") == "p2")
+
+local function nested(a)
+	local p = {pos={a, a}}
+	p.w = 1
+	return p.pos[2] + p.w
+end
+assert(nested(2) == 3)
+
+-- fresh table on each loop iteration.
+local last
+for i=1,3 do
+	local t = {}
+	if i == 1 then t.x = "first" end
+	last = t.x
+end
+assert(last == nil)
+
+print("ok")
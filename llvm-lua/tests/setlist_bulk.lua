@@ -0,0 +1,24 @@
+
+-- table constructors larger than one SETLIST batch.
+local function mk(i) return {i} end
+collectgarbage("setpause", 100)
+collectgarbage("setstepmul", 1000)
+for n=1,50 do
+	local t = {mk(1), mk(2), "a", 4, mk(5), 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+		21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43,
+		44, 45, 46, 47, 48, 49, 50, mk(51), mk(52), mk(53), {}, {}, {}, string.rep("x", n)}
+	collectgarbage("step")
+	assert(#t == 57 and t[1][1] == 1 and t[53][1] == 53 and t[57] == string.rep("x", n))
+end
+
+-- open SETLIST from a call and from varargs, with existing array entries.
+local function three() return 1, 2, 3 end
+local t = {three(), three()}
+assert(#t == 4 and t[4] == 3)
+local function va(...) return {0, ...} end
+t = va(mk(1), nil, mk(3))
+assert(t[1] == 0 and t[2][1] == 1 and t[3] == nil and t[4][1] == 3)
+t = {[1] = "x", [2] = "y", "a"}
+assert(t[1] == "a" and t[2] == "y")
+
+print("ok")
@@ -0,0 +1,25 @@
+-- long strings that differ in a single byte must stay distinct keys, even
+-- where the hash only samples their bytes
+local base = string.rep("http://example.com/path/", 40)
+local keys = {}
+for i=1,#base,3 do
+	local s = base:sub(1, i-1) .. "#" .. base:sub(i+1)
+	keys[#keys + 1] = s
+end
+
+local t = {}
+for i,s in ipairs(keys) do t[s] = i end
+for i,s in ipairs(keys) do
+	assert(t[s] == i)
+	assert(t[s:sub(1)] == i)  -- same string found through the string table
+end
+assert(t[base] == nil)
+
+-- short and empty strings
+local short = {}
+for i=0,255 do short[string.char(i)] = i end
+for i=0,255 do assert(short[string.char(i)] == i) end
+t[""] = 0
+assert(t[""] == 0 and t[("x"):sub(2)] == 0)
+
+print("ok")
@@ -0,0 +1,61 @@
+-- long strings are not interned, equal contents must still be equal
+local a = string.rep("abcdefghij", 10)
+local b = table.concat({ string.rep("abcdefghij", 5), string.rep("abcdefghij", 5) })
+assert(a == b and rawequal(a, b) and not (a ~= b))
+assert(#a == 100 and a:sub(1, 10) == "abcdefghij")
+assert(a .. "x" ~= b .. "y" and a .. "x" == b .. "x")
+assert(not (a < b) and a <= b and a .. "a" < b .. "b")
+assert(a ~= a:sub(1, 99) .. "X")
+
+-- table keys
+local t = {}
+t[a] = 1
+assert(t[b] == 1 and rawget(t, b) == 1)
+t[b] = 2
+assert(t[a] == 2)
+local n = 0
+for k,v in pairs(t) do n = n + 1; assert(k == a and v == 2) end
+assert(n == 1 and next(t, b) == nil)
+t[b] = nil
+assert(t[a] == nil and next(t) == nil)
+
+local keys = {}
+for i=1,2000 do
+	local k = string.rep("k", 50) .. i
+	keys[i] = k
+	t[k] = i
+end
+collectgarbage()
+for i=1,2000 do
+	assert(t[string.rep("k", 50) .. i] == i)
+	assert(t[keys[i]] == i)
+end
+for i=1,2000,2 do t[string.rep("k", 50) .. i] = nil end
+for i=1,2000 do assert(t[keys[i]] == (i % 2 == 0 and i or nil)) end
+
+-- long string constants and long names in nested functions
+local a_very_long_local_variable_name_that_is_not_interned_1 = 10
+local function outer()
+	local a_very_long_local_variable_name_that_is_not_interned_2 = 20
+	return function()
+		return a_very_long_local_variable_name_that_is_not_interned_1 +
+			a_very_long_local_variable_name_that_is_not_interned_2
+	end
+end
+assert(outer()() == 30)
+local k1 = "a long string constant that is longer than forty characters"
+local k2 = "a long string constant that is longer than forty characters"
+assert(k1 == k2)
+local obj = { ["a long string constant that is longer than forty characters"] = 5 }
+assert(obj[k1] == 5)
+assert(loadstring("return ...")(a) == b)
+
+-- big blobs are collected
+for i=1,50 do
+	local blob = string.rep("x", 100000) .. i
+	assert(#blob == 100000 + #tostring(i))
+end
+collectgarbage()
+assert(collectgarbage("count") < 4096)
+
+print("ok")
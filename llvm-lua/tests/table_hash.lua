@@ -0,0 +1,47 @@
+-- hash part chains: random inserts, deletes and rehashes checked against
+-- a plain list of the live keys
+math.randomseed(42)
+local keyspace = {}
+for i=1,400 do
+	local r = i % 5
+	if r == 0 then keyspace[i] = "s" .. i
+	elseif r == 1 then keyspace[i] = i * 0.5
+	elseif r == 2 then keyspace[i] = -i
+	elseif r == 3 then keyspace[i] = { i }
+	else keyspace[i] = i end  -- may go to the array part
+end
+
+for round=1,30 do
+	local t, live = {}, {}
+	for step=1,3000 do
+		local k = keyspace[math.random(#keyspace)]
+		if math.random() < 0.6 then
+			t[k] = step; live[k] = step
+		else
+			t[k] = nil; live[k] = nil
+		end
+	end
+	local n = 0
+	for k,v in pairs(t) do
+		n = n + 1
+		assert(live[k] == v)
+	end
+	for k,v in pairs(live) do
+		assert(t[k] == v)
+		n = n - 1
+	end
+	assert(n == 0)
+	-- clear entries while traversing
+	for k in pairs(t) do t[k] = nil end
+	assert(next(t) == nil)
+end
+
+-- keys colliding in one chain (same low bits)
+local t = {}
+for i=1,1000 do t[i * 1024 + 0.5] = i end
+for i=1,1000,3 do t[i * 1024 + 0.5] = nil end
+for i=1,1000 do
+	assert(t[i * 1024 + 0.5] == ((i - 1) % 3 ~= 0 and i or nil))
+end
+
+print("ok")
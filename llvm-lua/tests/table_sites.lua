@@ -0,0 +1,49 @@
+
+-- tables sized from the previous table created at the same site.
+local function make(n)
+	local t = {}
+	for i=1,n do
+		t[i] = i
+		t["k" .. i] = i
+	end
+	return t
+end
+for round=1,3 do
+	for n=0,40,8 do
+		local t = make(n)
+		assert(#t == n and t["k" .. n] == (n > 0 and n or nil))
+	end
+end
+
+-- tables that outlive the function that created them.
+local keep = {}
+for i=1,50 do
+	local f = loadstring("return {x = " .. i .. ", " .. i .. "}")
+	keep[i] = f()
+	keep[i].y = i
+end
+collectgarbage()
+for i=1,50 do
+	assert(keep[i].x == i and keep[i][1] == i and keep[i].y == i)
+end
+keep = nil
+collectgarbage()
+
+-- one big table must not presize every later table from the same site.
+local function new() return {} end
+local big = new()
+for i=1,20000 do big[i] = i; big[-i] = i end
+local small = {}
+collectgarbage()
+local before = collectgarbage("count")
+for i=1,50 do
+	local t = new()
+	t[1] = i
+	small[i] = t
+end
+assert(collectgarbage("count") - before < 512)
+for i=1,50 do assert(small[i][1] == i and small[i][2] == nil) end
+big, small = nil, nil
+collectgarbage()
+
+print("ok")
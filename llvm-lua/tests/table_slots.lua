@@ -0,0 +1,81 @@
+-- field accesses with constant string keys cache the node of the key,
+-- the cached node must be checked against every table it is used with
+local function point(x, y) return { x = x, y = y } end
+local function sum(list)
+	local s = 0
+	for i=1,#list do
+		local p = list[i]
+		p.x = p.x + 1
+		s = s + p.x + p.y
+	end
+	return s
+end
+
+-- same layout, then tables with other sizes and key orders at the same ops
+local list = {}
+for i=1,100 do list[i] = point(i, 1) end
+assert(sum(list) == 5050 + 100 + 100)
+for i=1,100 do
+	local r = i % 4
+	if r == 0 then list[i] = { y = 1, x = i }
+	elseif r == 1 then list[i] = { a = 1, b = 2, c = 3, x = i, y = 1 }
+	elseif r == 2 then list[i] = setmetatable({ y = 1 }, { __index = { x = i } })
+	else list[i] = point(i, 1) end
+end
+assert(sum(list) == 5050 + 100 + 100)
+for i=2,100,4 do assert(rawget(list[i], "x") == i + 1) end
+
+-- removed fields, tag methods and rehashes after the node was cached
+local p = point(1, 2)
+local function getx(t) return t.x end
+local function setx(t, v) t.x = v end
+assert(getx(p) == 1)
+setx(p, nil)
+assert(getx(p) == nil and next(p) == "y")
+setmetatable(p, { __index = function(t, k) return k .. "!" end,
+	__newindex = function(t, k, v) rawset(t, k, v * 10) end })
+assert(getx(p) == "x!")
+setx(p, 5)
+assert(getx(p) == 50)
+setx(p, 6)  -- existing field, no __newindex
+assert(getx(p) == 6)
+for i=1,100 do p["k" .. i] = i end
+assert(getx(p) == 6 and p.y == 2)
+setx(p, 7)
+assert(getx(p) == 7)
+
+-- methods found in the class
+local Class = {}
+Class.__index = Class
+function Class:get() return self.v end
+function Class:set(v) self.v = v end
+local objs = {}
+for i=1,50 do
+	objs[i] = setmetatable({}, Class)
+	objs[i]:set(i)
+end
+local s = 0
+for i=1,50 do s = s + objs[i]:get() end
+assert(s == 1275)
+objs[7].get = function() return -1 end  -- method shadowed by a field
+assert(objs[7]:get() == -1 and objs[8]:get() == 8)
+Class.get = function(self) return self.v * 2 end
+assert(objs[8]:get() == 16)
+assert(("abc"):upper() == "ABC")
+
+-- long keys are not interned, equal keys may be other objects
+local t = {}
+t["a field name that is longer than forty characters, twice over"] = 1
+for i=1,3 do
+	assert(t["a field name that is longer than forty characters, twice over"] == i)
+	t["a field name that is longer than forty characters, twice over"] = i + 1
+end
+
+-- errors
+assert(not pcall(function() local n = nil; return n.x end))
+assert(not pcall(function() local n = nil; n.x = 1 end))
+local loop = {}
+setmetatable(loop, { __index = loop })
+assert(not pcall(function() return loop.x end))
+
+print("ok")
@@ -0,0 +1,51 @@
+
+-- generic for loops over the standard ipairs/next iterators.
+local t = {10, 20, 30, nil, 50, x = 1, y = 2, z = 3}
+local n, sum = 0, 0
+for i,v in ipairs(t) do
+	n = n + 1
+	sum = sum + i * v
+end
+assert(n == 3 and sum == 10 + 40 + 90)
+
+-- one and three loop variables.
+n = 0
+for k in pairs(t) do n = n + 1 end
+assert(n == 7)
+for k,v,extra in pairs(t) do
+	assert(t[k] == v and extra == nil)
+end
+
+-- clearing fields while traversing.
+local h = {}
+for i=1,100 do h["k" .. i] = i end
+for i=1,100 do h[i] = i end
+n = 0
+for k,v in pairs(h) do
+	h[k] = nil
+	n = n + 1
+end
+assert(n == 200 and next(h) == nil)
+
+-- start from a key.
+local s = {a = 1, b = 2, c = 3}
+local first = next(s)
+n = 0
+for k,v in next,s,first do
+	assert(k ~= first)
+	n = n + 1
+end
+assert(n == 2)
+
+-- non-standard iterator.
+local function range(max, i)
+	if i < max then return i + 1 end
+end
+n = 0
+for i in range,5,0 do n = n + i end
+assert(n == 15)
+
+-- invalid key.
+assert(not pcall(function() for k in next,{},"missing" do end end))
+
+print("ok")
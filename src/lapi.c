@@ -938,10 +938,12 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
         g->GCthreshold = 0;
       while (g->GCthreshold <= g->totalbytes) {
         luaC_step(L);
-        if (g->gcstate == GCSpause) {  /* end of cycle? */
+        if (g->gcstate == GCSpause || isgenerational(g)) {  /* end of cycle? */
           res = 1;  /* signal it */
           break;
         }
+        if (data == 0 && g->gcsteptime > 0)
+          break;  /* one time-bounded step, the debt is left for later */
       }
       break;
     }
@@ -973,6 +975,26 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       res = cast_int(g->memlimit >> 10);
       break;
     }
+    case LUA_GCGEN: {
+      if (data > 0) g->gcminormul = data;
+      res = (luaC_changemode(L, KGC_GEN) == KGC_GEN) ? LUA_GCGEN : LUA_GCINC;
+      break;
+    }
+    case LUA_GCINC: {
+      res = (luaC_changemode(L, KGC_NORMAL) == KGC_GEN) ? LUA_GCGEN : LUA_GCINC;
+      break;
+    }
+    case LUA_GCSETSTEPTIME: {
+      res = g->gcsteptime;
+      g->gcsteptime = (data > 0) ? data : 0;
+      break;
+    }
+    case LUA_GCBGFREE: {
+      res = (g->freeq != NULL);
+      if (luaM_setbgfree(L, data) < 0)
+        res = -1;  /* not compiled in */
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -980,6 +1002,56 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
 }
 
 
+/*
+** push the collector timings: for each kind of collector work a table with
+** `count', `total' and `max' (microseconds) and `hist', where hist[i] counts
+** the samples below 2^(i-1) microseconds.  `limit' and `allocfail' count
+** the collections forced by the memory limit and by failed allocations.
+** Returns 0 and pushes nothing when LUA_USE_GCSTATS is off.
+*/
+LUA_API int lua_gcstats (lua_State *L, int reset) {
+#if defined(LUA_USE_GCSTATS)
+  static const char *const kinds[GCSTAT_N] = {"propagate", "atomic",
+    "sweepstring", "sweep", "finalize", "step", "fullgc"};
+  GCStats s;
+  int k, i;
+  lua_lock(L);
+  s = G(L)->gcstats;
+  if (reset) {  /* clear the counters */
+    memset(G(L)->gcstats.times, 0, sizeof(G(L)->gcstats.times));
+    G(L)->gcstats.nlimit = G(L)->gcstats.nallocfail = 0;
+  }
+  lua_unlock(L);
+  lua_createtable(L, 0, GCSTAT_N + 2);
+  for (k = 0; k < GCSTAT_N; k++) {
+    GCTimes *t = &s.times[k];
+    lua_createtable(L, 0, 4);
+    lua_pushnumber(L, (lua_Number)t->count);
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, t->total);
+    lua_setfield(L, -2, "total");
+    lua_pushnumber(L, t->max);
+    lua_setfield(L, -2, "max");
+    lua_createtable(L, GCSTAT_NBUCKETS, 0);
+    for (i = 0; i < GCSTAT_NBUCKETS; i++) {
+      lua_pushnumber(L, (lua_Number)t->hist[i]);
+      lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "hist");
+    lua_setfield(L, -2, kinds[k]);
+  }
+  lua_pushnumber(L, (lua_Number)s.nlimit);
+  lua_setfield(L, -2, "limit");
+  lua_pushnumber(L, (lua_Number)s.nallocfail);
+  lua_setfield(L, -2, "allocfail");
+  return 1;
+#else
+  (void)L; (void)reset;
+  return 0;
+#endif
+}
+
+
 
 /*
 ** miscellaneous functions
@@ -1041,6 +1113,7 @@ LUA_API lua_Alloc lua_getallocf (lua_State *L, void **ud) {
 
 LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud) {
   lua_lock(L);
+  luaM_syncfree(L);  /* free thread must be done with the old allocator */
   G(L)->ud = ud;
   G(L)->frealloc = f;
   lua_unlock(L);
@@ -12,6 +12,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(LUA_USE_BGFREE)
+#include <pthread.h>
+#endif
+
 
 /* This file uses only the official API of Lua.
 ** Any function declared here could be written as an application function.
@@ -682,9 +686,18 @@ static int l_check_memlimit(lua_State *L, size_t needbytes) {
   if (needbytes > g->memlimit) return 1;
   /* make sure the GC is not disabled. */
   if (!is_block_gc(L)) {
+    if (g->totalbytes >= limit)
+      luaC_countlimit(g);
     while (g->totalbytes >= limit) {
+      if (isgenerational(g)) {
+        /* a step is a minor collection, then try a major one. */
+        if (cycle_count++ > 0) {
+          luaC_fullgc(L);
+          break;
+        }
+      }
       /* only allow the GC to finished atleast 1 full cycle. */
-      if (g->gcstate == GCSpause && ++cycle_count > 1) break;
+      else if (g->gcstate == GCSpause && ++cycle_count > 1) break;
       luaC_step(L);
     }
   }
@@ -692,6 +705,7 @@ static int l_check_memlimit(lua_State *L, size_t needbytes) {
 }
 
 
+#if !defined(LUA_USE_POOLALLOC)
 static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   lua_State *L = (lua_State *)ud;
   void *nptr;
@@ -705,11 +719,13 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   }
   nptr = realloc(ptr, nsize);
   if (nptr == NULL && L != NULL) {
+    luaC_countallocfail(G(L));
     luaC_fullgc(L); /* emergency full collection. */
     nptr = realloc(ptr, nsize); /* try allocation again */
   }
   return nptr;
 }
+#endif
 
 
 static int panic (lua_State *L) {
@@ -720,10 +736,201 @@ static int panic (lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** Size-class pool allocator
+** =======================================================
+*/
+
+/*
+** Blocks up to POOL_MAXSIZE bytes are rounded up to a multiple of
+** POOL_GRAIN and served from per-class free lists; new blocks are cut
+** from POOL_PAGESIZE pages shared by all classes.  Freed blocks go back to
+** their class list and pages are only released when the state is closed.
+** The pool belongs to one state, so it needs no locking, except for the
+** blocks freed by the background free thread (LUA_USE_BGFREE), which are
+** put on a separate locked list and taken back when a class runs dry.
+** Larger blocks use realloc/free directly.  The memory limit and
+** emergency collection work as in `l_alloc'.
+*/
+
+#define POOL_GRAIN	sizeof(L_Umaxalign)
+#define POOL_MAXSIZE	256
+#define POOL_NCLASSES	(POOL_MAXSIZE/POOL_GRAIN)
+#define POOL_PAGESIZE	(16*1024)
+
+#define poolclass(s)	(((s) - 1) / POOL_GRAIN)
+#define ispooled(s)	((s) <= POOL_MAXSIZE)
+
+
+typedef struct PoolBlock {
+  struct PoolBlock *next;
+} PoolBlock;
+
+
+typedef union PoolPage {
+  union PoolPage *next;
+  L_Umaxalign dummy;  /* blocks after the header keep maximum alignment */
+} PoolPage;
+
+
+typedef struct Pool {
+  lua_State *L;
+  PoolBlock *freelist[POOL_NCLASSES];
+  PoolPage *pages;
+  char *bump;  /* unused part of the newest page */
+  size_t bumpleft;
+#if defined(LUA_USE_BGFREE)
+  pthread_t owner;
+  pthread_mutex_t lock;
+  PoolBlock *remote[POOL_NCLASSES];  /* blocks freed by other threads */
+#endif
+} Pool;
+
+
+static void pool_destroy (Pool *pool) {
+  PoolPage *p = pool->pages;
+  while (p != NULL) {
+    PoolPage *next = p->next;
+    free(p);
+    p = next;
+  }
+#if defined(LUA_USE_BGFREE)
+  pthread_mutex_destroy(&pool->lock);
+#endif
+  free(pool);
+}
+
+
+static void *pool_get (Pool *pool, size_t size) {
+  int c = poolclass(size);
+  size_t csize = (c + 1) * POOL_GRAIN;
+  PoolBlock *b = pool->freelist[c];
+  if (b != NULL) {
+    pool->freelist[c] = b->next;
+    return b;
+  }
+#if defined(LUA_USE_BGFREE)
+  pthread_mutex_lock(&pool->lock);
+  b = pool->remote[c];
+  pool->remote[c] = NULL;
+  pthread_mutex_unlock(&pool->lock);
+  if (b != NULL) {
+    pool->freelist[c] = b->next;
+    return b;
+  }
+#endif
+  if (pool->bumpleft < csize) {  /* need a new page? */
+    PoolPage *p = (PoolPage *)malloc(POOL_PAGESIZE);
+    if (p == NULL) return NULL;
+    p->next = pool->pages;
+    pool->pages = p;
+    pool->bump = (char *)(p + 1);
+    pool->bumpleft = POOL_PAGESIZE - sizeof(PoolPage);
+  }
+  b = (PoolBlock *)pool->bump;
+  pool->bump += csize;
+  pool->bumpleft -= csize;
+  return b;
+}
+
+
+static void pool_put (Pool *pool, void *ptr, size_t size) {
+  int c = poolclass(size);
+  PoolBlock *b = (PoolBlock *)ptr;
+#if defined(LUA_USE_BGFREE)
+  if (!pthread_equal(pthread_self(), pool->owner)) {
+    pthread_mutex_lock(&pool->lock);
+    b->next = pool->remote[c];
+    pool->remote[c] = b;
+    pthread_mutex_unlock(&pool->lock);
+    return;
+  }
+#endif
+  b->next = pool->freelist[c];
+  pool->freelist[c] = b;
+}
+
+
+static void *pool_malloc (Pool *pool, size_t nsize) {
+  return ispooled(nsize) ? pool_get(pool, nsize) : malloc(nsize);
+}
+
+
+static void *pool_realloc (Pool *pool, void *ptr, size_t osize, size_t nsize) {
+  void *nptr;
+  if (osize == 0)
+    return pool_malloc(pool, nsize);
+  if (!ispooled(osize) && !ispooled(nsize))
+    return realloc(ptr, nsize);
+  if (ispooled(osize) && ispooled(nsize) && poolclass(osize) == poolclass(nsize))
+    return ptr;  /* same size class */
+  nptr = pool_malloc(pool, nsize);
+  if (nptr == NULL) return NULL;
+  memcpy(nptr, ptr, (osize < nsize) ? osize : nsize);
+  if (ispooled(osize)) pool_put(pool, ptr, osize);
+  else free(ptr);
+  return nptr;
+}
+
+
+static void *l_poolalloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  Pool *pool = (Pool *)ud;
+  lua_State *L = pool->L;
+  void *nptr;
+  if (nsize == 0) {
+    /* the main state is the last block freed by lua_close */
+    int closing = (L != NULL && (lu_byte *)ptr + LUAI_EXTRASPACE == (lu_byte *)L);
+    if (ptr == NULL) return NULL;
+    if (ispooled(osize)) pool_put(pool, ptr, osize);
+    else free(ptr);
+    if (closing) pool_destroy(pool);
+    return NULL;
+  }
+  if(nsize > osize && L != NULL) {
+    if(G(L)->memlimit > 0 && l_check_memlimit(L, nsize - osize))
+      return NULL;
+  }
+  nptr = pool_realloc(pool, ptr, osize, nsize);
+  if (nptr == NULL && L != NULL) {
+    luaC_countallocfail(G(L));
+    luaC_fullgc(L); /* emergency full collection. */
+    nptr = pool_realloc(pool, ptr, osize, nsize); /* try allocation again */
+  }
+  return nptr;
+}
+
+
+LUALIB_API lua_State *luaL_newpoolstate (void) {
+  lua_State *L;
+  Pool *pool = (Pool *)malloc(sizeof(Pool));
+  if (pool == NULL) return NULL;
+  memset(pool, 0, sizeof(Pool));
+#if defined(LUA_USE_BGFREE)
+  pool->owner = pthread_self();
+  pthread_mutex_init(&pool->lock, NULL);
+#endif
+  L = lua_newstate(l_poolalloc, pool);
+  if (L == NULL) {
+    pool_destroy(pool);
+    return NULL;
+  }
+  pool->L = L;  /* allocator need lua_State. */
+  lua_atpanic(L, &panic);
+  return L;
+}
+
+/* }====================================================== */
+
+
 LUALIB_API lua_State *luaL_newstate (void) {
+#if defined(LUA_USE_POOLALLOC)
+  return luaL_newpoolstate();
+#else
   lua_State *L = lua_newstate(l_alloc, NULL);
   lua_setallocf(L, l_alloc, L); /* allocator need lua_State. */
   if (L) lua_atpanic(L, &panic);
   return L;
+#endif
 }
 
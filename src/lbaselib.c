@@ -18,6 +18,7 @@
 
 #include "lauxlib.h"
 #include "lualib.h"
+#include "lfastcall.h"
 #ifndef COCO_DISABLE
 #include "lcoco.h"
 #endif
@@ -195,13 +196,20 @@ static int luaB_gcinfo (lua_State *L) {
 
 static int luaB_collectgarbage (lua_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
-    "count", "step", "setpause", "setstepmul","setmemlimit","getmemlimit", NULL};
+    "count", "step", "setpause", "setstepmul","setmemlimit","getmemlimit",
+    "generational", "incremental", "bgfree", "setsteptime", "stats", NULL};
   static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
     LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
-		LUA_GCSETMEMLIMIT,LUA_GCGETMEMLIMIT};
+		LUA_GCSETMEMLIMIT,LUA_GCGETMEMLIMIT,LUA_GCGEN,LUA_GCINC,
+		LUA_GCBGFREE, LUA_GCSETSTEPTIME, -1};
   int o = luaL_checkoption(L, 1, "collect", opts);
   int ex = luaL_optint(L, 2, 0);
-  int res = lua_gc(L, optsnum[o], ex);
+  int res;
+  if (optsnum[o] < 0) {  /* "stats" */
+    if (!lua_gcstats(L, ex)) lua_pushnil(L);  /* not available */
+    return 1;
+  }
+  res = lua_gc(L, optsnum[o], ex);
   switch (optsnum[o]) {
     case LUA_GCCOUNT: {
       int b = lua_gc(L, LUA_GCCOUNTB, 0);
@@ -212,6 +220,16 @@ static int luaB_collectgarbage (lua_State *L) {
       lua_pushboolean(L, res);
       return 1;
     }
+    case LUA_GCGEN:
+    case LUA_GCINC: {  /* return previous mode */
+      lua_pushstring(L, (res == LUA_GCGEN) ? "generational" : "incremental");
+      return 1;
+    }
+    case LUA_GCBGFREE: {  /* return previous setting */
+      if (res < 0) lua_pushnil(L);  /* not available */
+      else lua_pushboolean(L, res);
+      return 1;
+    }
     default: {
       lua_pushnumber(L, res);
       return 1;
@@ -227,7 +245,7 @@ static int luaB_type (lua_State *L) {
 }
 
 
-static int luaB_next (lua_State *L) {
+int luaB_next (lua_State *L) {
   luaL_checktype(L, 1, LUA_TTABLE);
   lua_settop(L, 2);  /* create a 2nd argument if there isn't one */
   if (lua_next(L, 1))
@@ -248,7 +266,7 @@ static int luaB_pairs (lua_State *L) {
 }
 
 
-static int ipairsaux (lua_State *L) {
+int luaB_ipairsaux (lua_State *L) {
   int i = luaL_checkint(L, 2);
   luaL_checktype(L, 1, LUA_TTABLE);
   i++;  /* next value */
@@ -448,32 +466,32 @@ static int luaB_newproxy (lua_State *L) {
 }
 
 
-static const luaL_Reg base_funcs[] = {
-  {"assert", luaB_assert},
-  {"collectgarbage", luaB_collectgarbage},
-  {"dofile", luaB_dofile},
-  {"error", luaB_error},
-  {"gcinfo", luaB_gcinfo},
-  {"getfenv", luaB_getfenv},
-  {"getmetatable", luaB_getmetatable},
-  {"loadfile", luaB_loadfile},
-  {"load", luaB_load},
-  {"loadstring", luaB_loadstring},
-  {"next", luaB_next},
-  {"pcall", luaB_pcall},
-  {"print", luaB_print},
-  {"rawequal", luaB_rawequal},
-  {"rawget", luaB_rawget},
-  {"rawset", luaB_rawset},
-  {"select", luaB_select},
-  {"setfenv", luaB_setfenv},
-  {"setmetatable", luaB_setmetatable},
-  {"tonumber", luaB_tonumber},
-  {"tostring", luaB_tostring},
-  {"type", luaB_type},
-  {"unpack", luaB_unpack},
-  {"xpcall", luaB_xpcall},
-  {NULL, NULL}
+static const luaL_Reg3 base_funcs[] = {
+  {"assert", luaB_assert, NULL},
+  {"collectgarbage", luaB_collectgarbage, NULL},
+  {"dofile", luaB_dofile, NULL},
+  {"error", luaB_error, NULL},
+  {"gcinfo", luaB_gcinfo, NULL},
+  {"getfenv", luaB_getfenv, NULL},
+  {"getmetatable", luaB_getmetatable, NULL},
+  {"loadfile", luaB_loadfile, NULL},
+  {"load", luaB_load, NULL},
+  {"loadstring", luaB_loadstring, NULL},
+  {"next", luaB_next, NULL},
+  {"pcall", luaB_pcall, NULL},
+  {"print", luaB_print, NULL},
+  {"rawequal", luaB_rawequal, NULL},
+  {"rawget", luaB_rawget, luaFC_rawget},
+  {"rawset", luaB_rawset, luaFC_rawset},
+  {"select", luaB_select, luaFC_select},
+  {"setfenv", luaB_setfenv, NULL},
+  {"setmetatable", luaB_setmetatable, NULL},
+  {"tonumber", luaB_tonumber, luaFC_tonumber},
+  {"tostring", luaB_tostring, luaFC_tostring},
+  {"type", luaB_type, luaFC_type},
+  {"unpack", luaB_unpack, NULL},
+  {"xpcall", luaB_xpcall, NULL},
+  {NULL, NULL, NULL}
 };
 
 
@@ -651,11 +669,11 @@ static void base_open (lua_State *L) {
   lua_pushvalue(L, LUA_GLOBALSINDEX);
   lua_setglobal(L, "_G");
   /* open lib into global table */
-  luaL_register(L, "_G", base_funcs);
+  luaL_register3(L, "_G", base_funcs);
   lua_pushliteral(L, LUA_VERSION);
   lua_setglobal(L, "_VERSION");  /* set global _VERSION */
   /* `ipairs' and `pairs' need auxliliary functions as upvalues */
-  auxopen(L, "ipairs", luaB_ipairs, ipairsaux);
+  auxopen(L, "ipairs", luaB_ipairs, luaB_ipairsaux);
   auxopen(L, "pairs", luaB_pairs, luaB_next);
   /* `newproxy' needs a weaktable as upvalue */
   lua_createtable(L, 0, 1);  /* new table `w' */
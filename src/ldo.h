@@ -36,6 +36,36 @@
 #define PCRTAILRECUR	4	/* JIT function tail-recursive call */
 
 
+/*
+** A fast-call is a 'lua_precall' hook installed with luaL_register3.  It is
+** called by luaD_precall after the new CallInfo is allocated but before it
+** is set up.  It checks its arguments in place ('func + 1' up to 'L->top')
+** and either stores its results from 'func' on and returns with
+** 'fastcall_return', or falls back to the normal C call with
+** 'luaD_precall_c(L, func, nresults)'.  It must not raise errors, those are
+** left to the C function.  Anything that can allocate or run a metamethod
+** must be done after 'fastcall_leave'.  'fastcall_return' needs lgc.h.
+*/
+
+/* number of arguments */
+#define fastcall_nargs(L,func)	cast_int((L)->top - ((func) + 1))
+
+/* hooks must see the call, use the normal C call. */
+#define fastcall_hooked(L)	((L)->hookmask & (LUA_MASKCALL | LUA_MASKRET))
+
+/* free the CallInfo allocated by luaD_precall. */
+#define fastcall_leave(L)	{ (L)->ci--; (L)->base = (L)->ci->base; }
+
+/* finish a call that stored 'n' results from 'func' on. */
+#define fastcall_return(L,func,nresults,n) { \
+  StkId fc_res = (func) + (n); \
+  StkId fc_top = ((nresults) == LUA_MULTRET) ? fc_res : (func) + (nresults); \
+  while (fc_res < fc_top) setnilvalue(fc_res++); \
+  (L)->top = fc_top; \
+  luaC_checkGC(L); \
+  return PCRC; }
+
+
 /* type of protected functions, to be ran by `runprotected' */
 typedef void (*Pfunc) (lua_State *L, void *ud);
 
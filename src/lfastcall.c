@@ -0,0 +1,242 @@
+/*
+** Fast-calls: 'lua_precall' hooks for simple library functions
+** See Copyright Notice in lua.h
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+
+#define lfastcall_c
+#define LUA_CORE
+
+#include "lua.h"
+
+#include "ldo.h"
+#include "lfastcall.h"
+#include "lgc.h"
+#include "lobject.h"
+#include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
+#include "ltm.h"
+#include "lvm.h"
+
+
+/* macro to `unsign' a character */
+#define uchar(c)        ((unsigned char)(c))
+
+
+static ptrdiff_t fastcall_posrelat (ptrdiff_t pos, size_t len) {
+  /* relative string position: negative means back from end */
+  if (pos < 0) pos += (ptrdiff_t)len + 1;
+  return (pos >= 0) ? pos : 0;
+}
+
+
+/*
+** {======================================================
+** Basic library
+** =======================================================
+*/
+
+int luaFC_tonumber (lua_State *L, StkId func, int nresults) {
+  int nargs = fastcall_nargs(L, func);
+  TValue n;
+  const TValue *o;
+  if (fastcall_hooked(L) || nargs < 1 || (nargs > 1 && !ttisnil(func+2)))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  o = luaV_tonumber(func+1, &n);
+  if (o != NULL) {
+    setobj2s(L, func, o);
+  }
+  else setnilvalue(func);
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_rawget (lua_State *L, StkId func, int nresults) {
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) < 2 || !ttistable(func+1))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  setobj2s(L, func, luaH_get(hvalue(func+1), func+2));
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_rawset (lua_State *L, StkId func, int nresults) {
+  Table *h;
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) < 3 || !ttistable(func+1) ||
+      ttisnil(func+2) || (ttisnumber(func+2) && nvalue(func+2) != nvalue(func+2)))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  h = hvalue(func+1);
+  setobj2t(L, luaH_set(L, h, func+2), func+3);
+  luaC_barriert(L, h, func+3);
+  setobjs2s(L, func, func+1);
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_select (lua_State *L, StkId func, int nresults) {
+  int n = fastcall_nargs(L, func);
+  int i;
+  if (fastcall_hooked(L) || n < 1)
+    return luaD_precall_c(L, func, nresults);
+  if (ttisstring(func+1) && *svalue(func+1) == '#') {
+    fastcall_leave(L);
+    setnvalue(func, cast_num(n-1));
+    fastcall_return(L, func, nresults, 1);
+  }
+  if (!ttisnumber(func+1))
+    return luaD_precall_c(L, func, nresults);
+  lua_number2int(i, nvalue(func+1));
+  if (i < 0) i = n + i;
+  else if (i > n) i = n;
+  if (i < 1)
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  n -= i;  /* number of results */
+  for (i = 0; i < n; i++)
+    setobjs2s(L, func+i, L->top-n+i);
+  fastcall_return(L, func, nresults, n);
+}
+
+int luaFC_tostring (lua_State *L, StkId func, int nresults) {
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) < 1 || !ttisnumber(func+1) ||
+      G(L)->mt[LUA_TNUMBER] != NULL)  /* no '__tostring' for numbers? */
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  setobjs2s(L, func, func+1);
+  luaV_tostring(L, func);
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_type (lua_State *L, StkId func, int nresults) {
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) < 1)
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  setsvalue2s(L, func, luaS_new(L, luaT_typenames[ttype(func+1)]));
+  fastcall_return(L, func, nresults, 1);
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** String library
+** =======================================================
+*/
+
+/* integer argument 'narg' of a fast-call, 'def' when it is absent or nil. */
+static int fastcall_optinteger (StkId func, int nargs, int narg, ptrdiff_t def,
+                                ptrdiff_t *res) {
+  lua_Integer i;
+  if (narg > nargs || ttisnil(func+narg)) {
+    *res = def;
+    return 1;
+  }
+  if (!ttisnumber(func+narg)) return 0;
+  lua_number2integer(i, nvalue(func+narg));
+  *res = (ptrdiff_t)i;
+  return 1;
+}
+
+int luaFC_strbyte (lua_State *L, StkId func, int nresults) {
+  int nargs = fastcall_nargs(L, func);
+  const char *s;
+  size_t l;
+  ptrdiff_t posi, pose;
+  int n, i;
+  if (fastcall_hooked(L) || nargs < 1 || !ttisstring(func+1) ||
+      !fastcall_optinteger(func, nargs, 2, 1, &posi))
+    return luaD_precall_c(L, func, nresults);
+  l = tsvalue(func+1)->len;
+  posi = fastcall_posrelat(posi, l);
+  if (!fastcall_optinteger(func, nargs, 3, posi, &pose))
+    return luaD_precall_c(L, func, nresults);
+  pose = fastcall_posrelat(pose, l);
+  if (posi <= 0) posi = 1;
+  if ((size_t)pose > l) pose = l;
+  if (posi <= pose && pose - posi >= L->stack_last - func)  /* no room for the results? */
+    return luaD_precall_c(L, func, nresults);
+  n = (posi > pose) ? 0 : (int)(pose - posi + 1);
+  fastcall_leave(L);
+  s = svalue(func+1);
+  for (i=0; i<n; i++)
+    setnvalue(func+i, cast_num(uchar(s[posi+i-1])));
+  fastcall_return(L, func, nresults, n);
+}
+
+int luaFC_strchar (lua_State *L, StkId func, int nresults) {
+  int n = fastcall_nargs(L, func);
+  char buff[LUA_MINSTACK];
+  int i, c;
+  if (fastcall_hooked(L) || n > LUA_MINSTACK)
+    return luaD_precall_c(L, func, nresults);
+  for (i=0; i<n; i++) {
+    if (!ttisnumber(func+1+i))
+      return luaD_precall_c(L, func, nresults);
+    lua_number2int(c, nvalue(func+1+i));
+    if (uchar(c) != c)  /* invalid value */
+      return luaD_precall_c(L, func, nresults);
+    buff[i] = uchar(c);
+  }
+  fastcall_leave(L);
+  setsvalue2s(L, func, luaS_newlstr(L, buff, n));
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_strlen (lua_State *L, StkId func, int nresults) {
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) < 1 || !ttisstring(func+1))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  setnvalue(func, cast_num(tsvalue(func+1)->len));
+  fastcall_return(L, func, nresults, 1);
+}
+
+int luaFC_strsub (lua_State *L, StkId func, int nresults) {
+  int nargs = fastcall_nargs(L, func);
+  size_t l;
+  ptrdiff_t start, end;
+  if (fastcall_hooked(L) || nargs < 2 || !ttisstring(func+1) || !ttisnumber(func+2) ||
+      !fastcall_optinteger(func, nargs, 2, 1, &start) ||
+      !fastcall_optinteger(func, nargs, 3, -1, &end))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  l = tsvalue(func+1)->len;
+  start = fastcall_posrelat(start, l);
+  end = fastcall_posrelat(end, l);
+  if (start < 1) start = 1;
+  if (end > (ptrdiff_t)l) end = (ptrdiff_t)l;
+  if (start == 1 && end == (ptrdiff_t)l) {  /* whole string? */
+    setobjs2s(L, func, func+1);
+  }
+  else if (start <= end) {
+    setsvalue2s(L, func, luaS_newlstr(L, svalue(func+1)+start-1, end-start+1));
+  }
+  else setsvalue2s(L, func, luaS_newlstr(L, "", 0));
+  fastcall_return(L, func, nresults, 1);
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Table library
+** =======================================================
+*/
+
+int luaFC_tinsert (lua_State *L, StkId func, int nresults) {
+  Table *h;
+  if (fastcall_hooked(L) || fastcall_nargs(L, func) != 2 || !ttistable(func+1))
+    return luaD_precall_c(L, func, nresults);
+  fastcall_leave(L);
+  h = hvalue(func+1);
+  setobj2t(L, luaH_setnum(L, h, luaH_getn(h) + 1), func+2);
+  luaC_barriert(L, h, func+2);
+  fastcall_return(L, func, nresults, 0);
+}
+
+/* }====================================================== */
+
@@ -0,0 +1,37 @@
+/*
+** Fast-calls: 'lua_precall' hooks for simple library functions
+** See Copyright Notice in lua.h
+*/
+
+#ifndef lfastcall_h
+#define lfastcall_h
+
+
+#include "lua.h"
+
+
+/*
+** The hooks are kept in the core so the libraries only need the
+** 'lua_precall' type to install them with luaL_register3.  See the
+** fast-call macros in ldo.h for how a hook works.
+*/
+
+/* basic library */
+LUAI_FUNC int luaFC_rawget (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_rawset (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_select (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_tonumber (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_tostring (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_type (lua_State *L, StkId func, int nresults);
+
+/* string library */
+LUAI_FUNC int luaFC_strbyte (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_strchar (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_strlen (lua_State *L, StkId func, int nresults);
+LUAI_FUNC int luaFC_strsub (lua_State *L, StkId func, int nresults);
+
+/* table library */
+LUAI_FUNC int luaFC_tinsert (lua_State *L, StkId func, int nresults);
+
+
+#endif
@@ -16,6 +16,7 @@
 #include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "ldo.h"
 
@@ -137,13 +138,24 @@ Proto *luaF_newproto (lua_State *L) {
   f->linedefined = 0;
   f->lastlinedefined = 0;
   f->source = NULL;
+  f->tsites = NULL;
+  f->sizetsites = 0;
+  f->keyslots = NULL;
+  f->sizekeyslots = 0;
   JIT_NEWPROTO(L, f);
   return f;
 }
 
 
 void luaF_freeproto (lua_State *L, Proto *f) {
+  int i;
   JIT_FREEPROTO(L, f);
+  for (i = 0; i < f->sizetsites; i++) {  /* unlink tables that outlive `f' */
+    if (f->tsites[i].last != NULL)
+      f->tsites[i].last->site = NULL;
+  }
+  luaM_freearray(L, f->tsites, f->sizetsites, TableSite);
+  luaM_freearray(L, f->keyslots, f->sizekeyslots, int);
   luaM_freearray(L, f->code, f->sizecode, Instruction);
   luaM_freearray(L, f->p, f->sizep, Proto *);
   luaM_freearray(L, f->k, f->sizek, TValue);
@@ -154,6 +166,64 @@ void luaF_freeproto (lua_State *L, Proto *f) {
 }
 
 
+/*
+** create the allocation sites of `f', one for each OP_NEWTABLE in pc order
+*/
+void luaF_newtablesites (lua_State *L, Proto *f) {
+  int pc, n = 0;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction i = f->code[pc];
+    if (GET_OPCODE(i) == OP_NEWTABLE) n++;
+    else if (GET_OPCODE(i) == OP_SETLIST && GETARG_C(i) == 0) pc++;
+  }
+  if (n == 0) return;
+  f->tsites = luaM_newvector(L, n, TableSite);
+  f->sizetsites = n;
+  for (pc = 0, n = 0; pc < f->sizecode; pc++) {
+    Instruction i = f->code[pc];
+    if (GET_OPCODE(i) == OP_NEWTABLE) {
+      TableSite *site = &f->tsites[n++];
+      site->last = NULL;
+      site->pc = pc;
+      site->narray = 0;
+      site->nhash = 0;
+    }
+    else if (GET_OPCODE(i) == OP_SETLIST && GETARG_C(i) == 0) pc++;
+  }
+}
+
+
+/*
+** find the allocation site of the OP_NEWTABLE at `pc'
+*/
+TableSite *luaF_tablesite (lua_State *L, Proto *f, int pc) {
+  int lo = 0, hi;
+  if (f->tsites == NULL)
+    luaF_newtablesites(L, f);
+  hi = f->sizetsites - 1;
+  while (lo <= hi) {
+    int m = (lo + hi) / 2;
+    if (f->tsites[m].pc < pc) lo = m + 1;
+    else if (f->tsites[m].pc > pc) hi = m - 1;
+    else return &f->tsites[m];
+  }
+  return NULL;
+}
+
+
+/*
+** create the key slots of `f' (see luaV_getstr) and return the one of `pc'
+*/
+int *luaF_newkeyslots (lua_State *L, Proto *f, int pc) {
+  int i;
+  lua_assert(f->keyslots == NULL && pc < f->sizecode);
+  f->keyslots = luaM_newvector(L, f->sizecode, int);
+  f->sizekeyslots = f->sizecode;
+  for (i = 0; i < f->sizekeyslots; i++) f->keyslots[i] = 0;
+  return &f->keyslots[pc];
+}
+
+
 void luaF_freeclosure (lua_State *L, Closure *c) {
   int size = (cl_isC(c)) ? sizeCclosure(c->c.nupvalues) :
                           sizeLclosure(c->l.nupvalues);
@@ -17,6 +17,9 @@
 #define sizeLclosure(n)	(cast(int, sizeof(LClosure)) + \
                          cast(int, sizeof(TValue *)*((n)-1)))
 
+#define luaF_keyslot(L,f,pc)	((f)->keyslots != NULL ? &(f)->keyslots[pc] : \
+                                 luaF_newkeyslots(L, f, pc))
+
 
 LUAI_FUNC Proto *luaF_newproto (lua_State *L);
 LUAI_FUNC Closure *luaF_newCclosure (lua_State *L, int nelems, Table *e);
@@ -27,6 +30,9 @@ LUAI_FUNC void luaF_close (lua_State *L, StkId level);
 LUAI_FUNC void luaF_freeproto (lua_State *L, Proto *f);
 LUAI_FUNC void luaF_freeclosure (lua_State *L, Closure *c);
 LUAI_FUNC void luaF_freeupval (lua_State *L, UpVal *uv);
+LUAI_FUNC void luaF_newtablesites (lua_State *L, Proto *f);
+LUAI_FUNC TableSite *luaF_tablesite (lua_State *L, Proto *f, int pc);
+LUAI_FUNC int *luaF_newkeyslots (lua_State *L, Proto *f, int pc);
 LUAI_FUNC const char *luaF_getlocalname (const Proto *func, int local_number,
                                          int pc);
 
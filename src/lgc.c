@@ -5,6 +5,7 @@
 */
 
 #include <string.h>
+#include <time.h>
 
 #define lgc_c
 #define LUA_CORE
@@ -27,9 +28,10 @@
 #define GCSWEEPMAX	40
 #define GCSWEEPCOST	10
 #define GCFINALIZECOST	100
+#define GCTABLECHUNK	1024  /* table slots traversed per chunk */
 
 
-#define maskmarks	cast_byte(~(bitmask(BLACKBIT)|WHITEBITS))
+#define maskmarks	cast_byte(~(bitmask(BLACKBIT)|WHITEBITS|bitmask(OLDBIT)))
 
 #define makewhite(g,x)	\
    ((x)->gch.marked = cast_byte(((x)->gch.marked & maskmarks) | luaC_white(g)))
@@ -59,6 +61,68 @@
 #define setthreshold(g)  (g->GCthreshold = (g->estimate/100) * g->gcpause)
 
 
+/*
+** Collector timings.  A timed call (luaC_step or luaC_fullgc) is cut in
+** slices at each phase change; each slice and each whole call adds one
+** sample to the histogram of its kind.
+*/
+#if defined(LUA_USE_GCSTATS)
+
+#define gcstatkind(st)	((st) <= GCSpropagate ? GCSTAT_PROPAGATE : (st))
+
+static void addtime (GCTimes *t, double us) {
+  int b = 0;
+  double lim = 1;
+  while (us >= lim && b < GCSTAT_NBUCKETS - 1) {
+    b++;
+    lim *= 2;
+  }
+  t->hist[b]++;
+  t->count++;
+  t->total += us;
+  if (us > t->max) t->max = us;
+}
+
+
+static void gcstat_phase (global_State *g, int kind) {
+  GCStats *s = &g->gcstats;
+  if (s->timing && kind != s->phase) {
+    double now;
+    luai_gcclock(now);
+    addtime(&s->times[s->phase], now - s->phasestart);
+    s->phase = kind;
+    s->phasestart = now;
+  }
+}
+
+
+static void gcstat_begin (global_State *g) {
+  GCStats *s = &g->gcstats;
+  luai_gcclock(s->callstart);
+  s->phasestart = s->callstart;
+  s->phase = gcstatkind(g->gcstate);
+  s->timing = 1;
+}
+
+
+static void gcstat_end (global_State *g, int kind) {
+  GCStats *s = &g->gcstats;
+  double now;
+  luai_gcclock(now);
+  addtime(&s->times[s->phase], now - s->phasestart);
+  addtime(&s->times[kind], now - s->callstart);
+  s->timing = 0;
+}
+
+#else
+
+#define gcstat_phase(g,kind)	((void)0)
+#define gcstat_begin(g)		((void)0)
+#define gcstat_end(g,kind)	((void)0)
+
+#endif
+
+
 static void removeentry (Node *n) {
   lua_assert(ttisnil(gval(n)));
   if (iscollectable(gkey(n)))
@@ -175,6 +239,13 @@ static int traversetable (global_State *g, Table *h) {
     }
   }
   if (weakkey && weakvalue) return 1;
+  if (!weakkey && !weakvalue && g->gcsteptime > 0 &&
+      h->sizearray + sizenode(h) > GCTABLECHUNK) {
+    /* big table in a time-bounded step: traverse it in chunks */
+    g->gcpartial = h;
+    g->gcpartialidx = h->sizearray + sizenode(h);
+    return 0;
+  }
   if (!weakvalue) {
     i = h->sizearray;
     while (i--)
@@ -278,8 +349,42 @@ static void traversestack (global_State *g, lua_State *l) {
 ** traverse one gray object, turning it to black.
 ** Returns `quantity' traversed.
 */
+/*
+** traverse the next chunk of `gcpartial'.  The table is black while it
+** is traversed, so stores into it go through `luaC_barrierback' and get
+** it traversed again by the atomic phase; a resize drops the partial
+** traversal (see `luaC_droppartial').
+*/
+static l_mem traversechunk (global_State *g) {
+  Table *h = g->gcpartial;
+  int i = g->gcpartialidx;
+  int stop = (i > GCTABLECHUNK) ? i - GCTABLECHUNK : 0;
+  lua_assert(!iswhite(obj2gco(h)));  /* gray if caught by a barrier */
+  while (i-- > stop) {
+    if (i < h->sizearray) {
+      markvalue(g, &h->array[i]);
+    }
+    else {
+      Node *n = gnode(h, i - h->sizearray);
+      if (ttisnil(gval(n)))
+        removeentry(n);  /* remove empty entries */
+      else {
+        markvalue(g, gkey(n));
+        markvalue(g, gval(n));
+      }
+    }
+  }
+  g->gcpartialidx = stop;
+  if (stop == 0)
+    g->gcpartial = NULL;
+  return GCTABLECHUNK * sizeof(TValue);
+}
+
+
 static l_mem propagatemark (global_State *g) {
   GCObject *o = g->gray;
+  if (g->gcpartial)
+    return traversechunk(g);
   lua_assert(isgray(o));
   gray2black(o);
   switch (o->gch.tt) {
@@ -288,6 +393,8 @@ static l_mem propagatemark (global_State *g) {
       g->gray = h->gclist;
       if (traversetable(g, h))  /* table is weak? */
         black2gray(o);  /* keep it gray */
+      if (g->gcpartial == h)  /* traversed later, in chunks */
+        return sizeof(Table);
       return sizeof(Table) + sizeof(TValue) * h->sizearray +
                              sizeof(Node) * sizenode(h);
     }
@@ -326,7 +433,7 @@ static l_mem propagatemark (global_State *g) {
 
 static size_t propagateall (global_State *g) {
   size_t m = 0;
-  while (g->gray) m += propagatemark(g);
+  while (g->gray || g->gcpartial) m += propagatemark(g);
   return m;
 }
 
@@ -380,6 +487,8 @@ static void cleartable (GCObject *l) {
 
 
 static void freeobj (lua_State *L, GCObject *o) {
+  global_State *g = G(L);
+  g->deferfree = (g->freeq != NULL);  /* hand the blocks to the free thread */
   switch (o->gch.tt) {
     case LUA_TPROTO: luaF_freeproto(L, gco2p(o)); break;
     case LUA_TFUNCTION: luaF_freeclosure(L, gco2cl(o)); break;
@@ -391,7 +500,8 @@ static void freeobj (lua_State *L, GCObject *o) {
       break;
     }
     case LUA_TSTRING: {
-      G(L)->strt.nuse--;
+      if (!islngstr(rawgco2ts(o)))
+        G(L)->strt.nuse--;
       luaM_freemem(L, o, sizestring(gco2ts(o)));
       break;
     }
@@ -401,6 +511,7 @@ static void freeobj (lua_State *L, GCObject *o) {
     }
     default: lua_assert(0);
   }
+  g->deferfree = 0;
 }
 
 
@@ -430,17 +541,49 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
 }
 
 
+/*
+** generational mode: sweep list `p' without changing the colors of live
+** objects, all of them become old.  Lists that only grow at their head
+** are young up to the first old object, with `stopold' the sweep stops
+** there.
+*/
+static void sweepgen (lua_State *L, GCObject **p, int stopold) {
+  GCObject *curr;
+  global_State *g = G(L);
+  int deadmask = otherwhite(g);
+  while ((curr = *p) != NULL) {
+    if (stopold && isold(curr))
+      return;  /* rest of the list is old */
+    if (curr->gch.tt == LUA_TTHREAD)  /* sweep open upvalues of each thread */
+      sweepgen(L, &gco2th(curr)->openupval, 0);
+    if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
+      if (iswhite(curr))  /* fixed or (dead) string left by a minor collection */
+        makewhite(g, curr);
+      else
+        l_setbit(curr->gch.marked, OLDBIT);
+      p = &curr->gch.next;
+    }
+    else {  /* must erase `curr' */
+      lua_assert(isdead(g, curr));
+      *p = curr->gch.next;
+      freeobj(L, curr);
+    }
+  }
+}
+
+
 static void checkSizes (lua_State *L) {
   global_State *g = G(L);
   /* check size of string hash */
   if (g->strt.nuse < cast(lu_int32, g->strt.size/4) &&
-      g->strt.size > MINSTRTABSIZE*2)
+      g->strt.size > MINSTRTABSIZE*2 && g->strt.oldhash == NULL)
     luaS_resize(L, g->strt.size/2);  /* table is too big */
   /* it is not safe to re-size the buffer if it is in use. */
   if (luaZ_bufflen(&g->buff) > 0) return;
   /* check size of buffer */
   if (luaZ_sizebuffer(&g->buff) > LUA_MINBUFFER*2) {  /* buffer too big? */
     size_t newsize = luaZ_sizebuffer(&g->buff) / 2;
+    luaC_freedlive(g, luaZ_sizebuffer(&g->buff) - newsize);
     luaZ_resizebuffer(L, &g->buff, newsize);
   }
 }
@@ -489,8 +632,8 @@ void luaC_freeall (lua_State *L) {
   int i;
   g->currentwhite = WHITEBITS | bitmask(SFIXEDBIT);  /* mask to collect all elements */
   sweepwholelist(L, &g->rootgc);
-  for (i = 0; i < g->strt.size; i++)  /* free all string lists */
-    sweepwholelist(L, &g->strt.hash[i]);
+  for (i = 0; i < strtsize(&g->strt); i++)  /* free all string lists */
+    sweepwholelist(L, strtlist(&g->strt, i));
 }
 
 
@@ -504,6 +647,7 @@ static void markmt (global_State *g) {
 /* mark root set */
 static void markroot (lua_State *L) {
   global_State *g = G(L);
+  g->gcpartial = NULL;
   g->gray = NULL;
   g->grayagain = NULL;
   g->weak = NULL;
@@ -529,6 +673,7 @@ static void remarkupvals (global_State *g) {
 static void atomic (lua_State *L) {
   global_State *g = G(L);
   size_t udsize;  /* total size of userdata to be finalized */
+  gcstat_phase(g, GCSTAT_ATOMIC);
   /* remark occasional upvalues of (maybe) dead threads */
   remarkupvals(g);
   /* traverse objects cautch by write barrier and by 'remarkupvals' */
@@ -554,6 +699,84 @@ static void atomic (lua_State *L) {
   g->sweepgc = &g->rootgc;
   g->gcstate = GCSsweepstring;
   g->estimate = g->totalbytes - udsize;  /* first estimate */
+  gcstat_phase(g, GCSTAT_SWEEPSTRING);
+}
+
+
+/*
+** turn all objects white (and young) and forget the gray lists.  Objects
+** left dead by an unfinished sweep phase are freed.
+*/
+static void whiteall (lua_State *L) {
+  global_State *g = G(L);
+  int i;
+  gcstat_phase(g, GCSTAT_SWEEP);
+  g->gcpartial = NULL;
+  g->gray = NULL;
+  g->grayagain = NULL;
+  g->weak = NULL;
+  for (i = 0; i < strtsize(&g->strt); i++)
+    sweepwholelist(L, strtlist(&g->strt, i));
+  sweepwholelist(L, &g->rootgc);
+}
+
+
+/*
+** generational mode: minor collection.  Old objects are black and are
+** neither traversed nor swept again; the write barriers put the old
+** objects that got young references in the gray lists.  Threads and weak
+** tables stay gray and are traversed by every collection.  The collector
+** stays in the propagate state between collections so the barriers keep
+** the invariant.
+** String lists are not ordered by age and have to be swept whole, that is
+** only done once enough new strings were created.  Dead strings left in
+** the table get freed by a later sweep (or reused by luaS_newlstr).
+*/
+static void youngcollection (lua_State *L, int full) {
+  global_State *g = G(L);
+  int i;
+  lua_assert(g->gcstate == GCSpropagate);
+  propagateall(g);
+  atomic(L);
+  if (full || g->strt.nuse > g->lastnusestr +
+                             (g->lastnusestr / 100) * g->gcminormul) {
+    for (i = 0; i < strtsize(&g->strt); i++)
+      sweepgen(L, strtlist(&g->strt, i), 0);
+    g->lastnusestr = g->strt.nuse;
+  }
+  gcstat_phase(g, GCSTAT_SWEEP);
+  sweepgen(L, &g->rootgc, 1);
+  sweepgen(L, &g->mainthread->next, 1);  /* userdata */
+  checkSizes(L);
+  g->gcstate = GCSpropagate;
+  g->estimate = g->totalbytes;
+}
+
+
+/*
+** generational mode: major collection, every live object is marked and
+** becomes old.
+*/
+static void fullgen (lua_State *L) {
+  global_State *g = G(L);
+  whiteall(L);
+  markroot(L);
+  gcstat_phase(g, GCSTAT_PROPAGATE);
+  youngcollection(L, 1);
+  g->lastmajor = g->totalbytes;
+}
+
+
+static void genstep (lua_State *L) {
+  global_State *g = G(L);
+  if (g->totalbytes > (g->lastmajor / 100) * g->gcpause)
+    fullgen(L);  /* heap grew too much since last major collection */
+  else
+    youngcollection(L, 0);
+  g->GCthreshold = g->totalbytes + (g->totalbytes / 100) * g->gcminormul;
+  g->gcdept = 0;
+  gcstat_phase(g, GCSTAT_FINALIZE);
+  luaC_callGCTM(L);
 }
 
 
@@ -566,7 +789,7 @@ static l_mem singlestep (lua_State *L) {
       return 0;
     }
     case GCSpropagate: {
-      if (g->gray)
+      if (g->gray || g->gcpartial)
         return propagatemark(g);
       else {  /* no more `gray' objects */
         atomic(L);  /* finish mark phase */
@@ -575,9 +798,11 @@ static l_mem singlestep (lua_State *L) {
     }
     case GCSsweepstring: {
       lu_mem old = g->totalbytes;
-      sweepwholelist(L, &g->strt.hash[g->sweepstrgc++]);
-      if (g->sweepstrgc >= g->strt.size)  /* nothing more to sweep? */
+      sweepwholelist(L, strtlist(&g->strt, g->sweepstrgc));
+      if (++g->sweepstrgc >= strtsize(&g->strt)) {  /* nothing more to sweep? */
         g->gcstate = GCSsweep;  /* end sweep-string phase */
+        gcstat_phase(g, GCSTAT_SWEEP);
+      }
       lua_assert(old >= g->totalbytes);
       g->estimate -= old - g->totalbytes;
       return GCSWEEPCOST;
@@ -585,12 +810,14 @@ static l_mem singlestep (lua_State *L) {
     case GCSsweep: {
       lu_mem old = g->totalbytes;
       g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
+      lua_assert(old >= g->totalbytes);
+      g->estimate -= old - g->totalbytes;
       if (*g->sweepgc == NULL) {  /* nothing more to sweep? */
+        /* a string table shrink only allocates here, frees update `estimate' */
         checkSizes(L);
         g->gcstate = GCSfinalize;  /* end sweep phase */
+        gcstat_phase(g, GCSTAT_FINALIZE);
       }
-      lua_assert(old >= g->totalbytes);
-      g->estimate -= old - g->totalbytes;
       return GCSWEEPMAX*GCSWEEPCOST;
     }
     case GCSfinalize: {
@@ -602,6 +829,7 @@ static l_mem singlestep (lua_State *L) {
       }
       else {
         g->gcstate = GCSpause;  /* end collection */
+        gcstat_phase(g, GCSTAT_PROPAGATE);
         g->gcdept = 0;
         return 0;
       }
@@ -611,21 +839,64 @@ static l_mem singlestep (lua_State *L) {
 }
 
 
+/*
+** time-bounded step: like the loop in `luaC_step', but also stops once
+** `gcsteptime' microseconds have passed (the clock is read every
+** GCSTEPSIZE units of work).  Work left undone is added to the debt, so
+** the next steps come sooner instead of this one running longer.
+*/
+static l_mem timedsteps (lua_State *L, l_mem lim) {
+  global_State *g = G(L);
+  double now, deadline;
+  l_mem work = 0;
+  luai_gcclock(deadline);
+  deadline += g->gcsteptime;
+  do {
+    l_mem w = singlestep(L);
+    lim -= w;
+    if (g->gcstate == GCSpause)
+      return lim;
+    work += w;
+    if (work >= (l_mem)GCSTEPSIZE) {
+      work = 0;
+      luai_gcclock(now);
+      if (now >= deadline) break;
+    }
+  } while (lim > 0);
+  if (lim > 0 && g->gcstepmul > 0)  /* out of time: carry the debt forward */
+    g->gcdept += (lim / g->gcstepmul) * 100;
+  return lim;
+}
+
+
 void luaC_step (lua_State *L) {
   global_State *g = G(L);
   if(is_block_gc(L)) return;
   set_block_gc(L);
+  gcstat_begin(g);
+  luaS_rehash(L, GCSWEEPMAX);  /* help an unfinished string table resize */
+  if (isgenerational(g)) {
+    genstep(L);
+    luaM_flushfree(L);
+    gcstat_end(g, GCSTAT_STEP);
+    unset_block_gc(L);
+    return;
+  }
   l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
   if (lim == 0)
     lim = (MAX_LUMEM-1)/2;  /* no limit */
   g->gcdept += g->totalbytes - g->GCthreshold;
   if (g->estimate > g->totalbytes)
     g->estimate = g->totalbytes;
-  do {
-    lim -= singlestep(L);
-    if (g->gcstate == GCSpause)
-      break;
-  } while (lim > 0);
+  if (g->gcsteptime > 0)
+    lim = timedsteps(L, lim);
+  else {
+    do {
+      lim -= singlestep(L);
+      if (g->gcstate == GCSpause)
+        break;
+    } while (lim > 0);
+  }
   if (g->gcstate != GCSpause) {
     if (g->gcdept < GCSTEPSIZE)
       g->GCthreshold = g->totalbytes + GCSTEPSIZE;  /* - lim/g->gcstepmul;*/
@@ -638,6 +909,8 @@ void luaC_step (lua_State *L) {
     lua_assert(g->totalbytes >= g->estimate);
     setthreshold(g);
   }
+  luaM_flushfree(L);
+  gcstat_end(g, GCSTAT_STEP);
   unset_block_gc(L);
 }
 
@@ -646,15 +919,28 @@ void luaC_fullgc (lua_State *L) {
   global_State *g = G(L);
   if(is_block_gc(L)) return;
   set_block_gc(L);
+  gcstat_begin(g);
+  if (isgenerational(g)) {
+    fullgen(L);
+    g->GCthreshold = g->totalbytes + (g->totalbytes / 100) * g->gcminormul;
+    gcstat_phase(g, GCSTAT_FINALIZE);
+    luaC_callGCTM(L);
+    luaM_flushfree(L);
+    gcstat_end(g, GCSTAT_FULLGC);
+    unset_block_gc(L);
+    return;
+  }
   if (g->gcstate <= GCSpropagate) {
     /* reset sweep marks to sweep all elements (returning them to white) */
     g->sweepstrgc = 0;
     g->sweepgc = &g->rootgc;
     /* reset other collector lists */
+    g->gcpartial = NULL;
     g->gray = NULL;
     g->grayagain = NULL;
     g->weak = NULL;
     g->gcstate = GCSsweepstring;
+    gcstat_phase(g, GCSTAT_SWEEPSTRING);
   }
   lua_assert(g->gcstate != GCSpause && g->gcstate != GCSpropagate);
   /* finish any pending sweep phase */
@@ -663,11 +949,42 @@ void luaC_fullgc (lua_State *L) {
     singlestep(L);
   }
   markroot(L);
+  gcstat_phase(g, GCSTAT_PROPAGATE);
   while (g->gcstate != GCSpause) {
     singlestep(L);
   }
   setthreshold(g);
+  luaM_flushfree(L);
+  gcstat_end(g, GCSTAT_FULLGC);
+  unset_block_gc(L);
+}
+
+
+/*
+** switch between incremental (KGC_NORMAL) and generational (KGC_GEN) mode,
+** returns the previous mode.  Entering generational mode runs a major
+** collection.
+*/
+int luaC_changemode (lua_State *L, int mode) {
+  global_State *g = G(L);
+  int oldmode = g->gckind;
+  if (mode == oldmode || is_block_gc(L)) return oldmode;
+  set_block_gc(L);
+  g->gckind = cast_byte(mode);
+  if (mode == KGC_GEN) {
+    fullgen(L);
+    g->GCthreshold = g->totalbytes + (g->totalbytes / 100) * g->gcminormul;
+  }
+  else {  /* back to a new incremental cycle */
+    whiteall(L);
+    g->gcstate = GCSpause;
+    g->estimate = g->totalbytes;
+    g->gcdept = 0;
+    setthreshold(g);
+  }
+  luaM_flushfree(L);
   unset_block_gc(L);
+  return oldmode;
 }
 
 
@@ -695,6 +1012,19 @@ void luaC_barrierback (lua_State *L, Table *t) {
 }
 
 
+/*
+** table `t' is being traversed in chunks and is about to be resized;
+** give up on it and let the atomic phase traverse it whole.
+*/
+void luaC_droppartial (lua_State *L, Table *t) {
+  global_State *g = G(L);
+  GCObject *o = obj2gco(t);
+  g->gcpartial = NULL;
+  if (isblack(o))  /* not already in `grayagain'? */
+    luaC_barrierback(L, t);
+}
+
+
 void luaC_marknew (lua_State *L, GCObject *o) {
   global_State *g = G(L);
   o->gch.marked = luaC_white(g);
@@ -717,6 +1047,7 @@ void luaC_linkupval (lua_State *L, UpVal *uv) {
   GCObject *o = obj2gco(uv);
   o->gch.next = g->rootgc;  /* link upvalue into `rootgc' list */
   g->rootgc = o;
+  resetbit(o->gch.marked, OLDBIT);  /* young objects are first in `rootgc' */
   if (isgray(o)) { 
     if (g->gcstate == GCSpropagate) {
       gray2black(o);  /* closed upvalues need barrier */
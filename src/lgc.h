@@ -21,6 +21,15 @@
 #define GCSfinalize	4
 
 
+/*
+** Kinds of Garbage Collection
+*/
+#define KGC_NORMAL	0
+#define KGC_GEN		1	/* generational */
+
+#define isgenerational(g)	((g)->gckind == KGC_GEN)
+
+
 /*
 ** some userful bit tricks
 */
@@ -62,6 +71,7 @@
 ** bit 4 - for tables: has weak values
 ** bit 5 - object is fixed (should not be collected)
 ** bit 6 - object is "super" fixed (only the main thread)
+** bit 7 - object is old (generational mode)
 */
 
 
@@ -74,12 +84,14 @@
 #define VALUEWEAKBIT	4
 #define FIXEDBIT	5
 #define SFIXEDBIT	6
+#define OLDBIT		7
 #define WHITEBITS	bit2mask(WHITE0BIT, WHITE1BIT)
 
 
 #define iswhite(x)      test2bits((x)->gch.marked, WHITE0BIT, WHITE1BIT)
 #define isblack(x)      testbit((x)->gch.marked, BLACKBIT)
 #define isgray(x)	(!isblack(x) && !iswhite(x))
+#define isold(x)	testbit((x)->gch.marked, OLDBIT)
 
 #define otherwhite(g)	(g->currentwhite ^ WHITEBITS)
 #define isdead(g,v)	((v)->gch.marked & otherwhite(g) & WHITEBITS)
@@ -114,16 +126,34 @@
 #define luaC_objbarriert(L,t,o)  \
    { if (iswhite(obj2gco(o)) && isblack(obj2gco(t))) luaC_barrierback(L,t); }
 
+/* `n' bytes of live memory were freed outside the sweep */
+#define luaC_freedlive(g,n) \
+   { (g)->estimate = ((g)->estimate > (n)) ? (g)->estimate - (n) : 0; }
+
+/* entries of table `t' are about to move */
+#define luaC_tableresize(L,t) \
+   { if (G(L)->gcpartial == (t)) luaC_droppartial(L,t); }
+
 LUAI_FUNC size_t luaC_separateudata (lua_State *L, int all);
 LUAI_FUNC void luaC_callGCTM (lua_State *L);
 LUAI_FUNC void luaC_freeall (lua_State *L);
 LUAI_FUNC void luaC_step (lua_State *L);
 LUAI_FUNC void luaC_fullgc (lua_State *L);
+LUAI_FUNC int luaC_changemode (lua_State *L, int mode);
+
+#if defined(LUA_USE_GCSTATS)
+#define luaC_countlimit(g)	((g)->gcstats.nlimit++)
+#define luaC_countallocfail(g)	((g)->gcstats.nallocfail++)
+#else
+#define luaC_countlimit(g)	((void)0)
+#define luaC_countallocfail(g)	((void)0)
+#endif
 LUAI_FUNC void luaC_marknew (lua_State *L, GCObject *o);
 LUAI_FUNC void luaC_link (lua_State *L, GCObject *o, lu_byte tt);
 LUAI_FUNC void luaC_linkupval (lua_State *L, UpVal *uv);
 LUAI_FUNC void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v);
 LUAI_FUNC void luaC_barrierback (lua_State *L, Table *t);
+LUAI_FUNC void luaC_droppartial (lua_State *L, Table *t);
 
 
 #endif
@@ -118,8 +118,11 @@ TString *luaX_newstring (LexState *ls, const char *str, size_t l) {
   lua_State *L = ls->L;
   TString *ts = luaS_newlstr(L, str, l);
   TValue *o = luaH_setstr(L, ls->fs->h, ts);  /* entry for `str' */
-  if (ttisnil(o))
+  if (ttisnil(o)) {
     setbvalue(o, 1);  /* make sure `str' will not be collected */
+  }
+  else  /* reuse the long string already anchored for `str' */
+    ts = rawtsvalue(key2tval(cast(Node *, o)));
   return ts;
 }
 
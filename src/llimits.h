@@ -100,6 +100,12 @@ typedef lu_int32 Instruction;
 #endif
 
 
+/* buckets moved by each `luaS_newlstr' while the string table is resized */
+#ifndef STRTREHASHSTEP
+#define STRTREHASHSTEP	4
+#endif
+
+
 /* minimum size for string buffer */
 #ifndef LUA_MINBUFFER
 #define LUA_MINBUFFER	32
@@ -7,6 +7,10 @@
 
 #include <stddef.h>
 
+#if defined(LUA_USE_BGFREE)
+#include <pthread.h>
+#endif
+
 #define lmem_c
 #define LUA_CORE
 
@@ -70,13 +74,170 @@ void *luaM_toobig (lua_State *L) {
 
 
 
+/*
+** Background freeing of dead objects.
+** While `deferfree' is set (the collector sets it around `freeobj'), blocks
+** freed through `luaM_realloc_' are not given back to `frealloc'; they are
+** chained into `pending' instead, reusing their first bytes as the link.
+** At the end of each collector step the pending chain is handed to a
+** worker thread, which makes the real `frealloc' calls.  `totalbytes' is
+** updated at once, so the collector pacing and the memory limit see the
+** block as freed even before the worker gets to it.
+*/
+#if defined(LUA_USE_BGFREE)
+
+typedef struct FreeBlock {
+  struct FreeBlock *next;
+  size_t size;
+} FreeBlock;
+
+struct FreeQueue {
+  global_State *g;
+  FreeBlock *pending;  /* blocks freed by the current step (mutator only) */
+  FreeBlock *lastpending;
+  FreeBlock *queue;  /* blocks handed to the worker (protected by `lock') */
+  int busy;  /* worker is freeing a batch */
+  int stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;  /* signals new work or `stop' to the worker */
+  pthread_cond_t idle;  /* signals that the worker finished a batch */
+  pthread_t thread;
+};
+
+
+static void *freeworker (void *ud) {
+  FreeQueue *q = cast(FreeQueue *, ud);
+  global_State *g = q->g;
+  pthread_mutex_lock(&q->lock);
+  for (;;) {
+    FreeBlock *b;
+    while (q->queue == NULL && !q->stop)
+      pthread_cond_wait(&q->wake, &q->lock);
+    if (q->queue == NULL) break;  /* stopped and nothing left to free */
+    b = q->queue;
+    q->queue = NULL;
+    q->busy = 1;
+    pthread_mutex_unlock(&q->lock);
+    while (b != NULL) {
+      FreeBlock *next = b->next;
+      (*g->frealloc)(g->ud, b, b->size, 0);
+      b = next;
+    }
+    pthread_mutex_lock(&q->lock);
+    q->busy = 0;
+    pthread_cond_broadcast(&q->idle);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return NULL;
+}
+
+
+static void deferfree (FreeQueue *q, void *block, size_t osize) {
+  FreeBlock *b = cast(FreeBlock *, block);
+  b->next = NULL;
+  b->size = osize;
+  if (q->pending == NULL)
+    q->pending = b;
+  else
+    q->lastpending->next = b;
+  q->lastpending = b;
+}
+
+
+void luaM_flushfree (lua_State *L) {
+  FreeQueue *q = G(L)->freeq;
+  if (q == NULL || q->pending == NULL) return;
+  pthread_mutex_lock(&q->lock);
+  q->lastpending->next = q->queue;
+  q->queue = q->pending;
+  pthread_cond_signal(&q->wake);
+  pthread_mutex_unlock(&q->lock);
+  q->pending = q->lastpending = NULL;
+}
+
+
+void luaM_syncfree (lua_State *L) {
+  FreeQueue *q = G(L)->freeq;
+  if (q == NULL) return;
+  luaM_flushfree(L);
+  pthread_mutex_lock(&q->lock);
+  while (q->queue != NULL || q->busy)
+    pthread_cond_wait(&q->idle, &q->lock);
+  pthread_mutex_unlock(&q->lock);
+}
+
+
+int luaM_setbgfree (lua_State *L, int on) {
+  global_State *g = G(L);
+  FreeQueue *q = g->freeq;
+  if (on && q == NULL) {
+    q = luaM_new(L, FreeQueue);
+    q->g = g;
+    q->pending = q->lastpending = q->queue = NULL;
+    q->busy = q->stop = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->wake, NULL);
+    pthread_cond_init(&q->idle, NULL);
+    if (pthread_create(&q->thread, NULL, freeworker, q) != 0) {
+      pthread_cond_destroy(&q->idle);
+      pthread_cond_destroy(&q->wake);
+      pthread_mutex_destroy(&q->lock);
+      luaM_free(L, q);
+      return 0;  /* cannot start the worker; keep freeing inline */
+    }
+    g->freeq = q;
+  }
+  else if (!on && q != NULL) {
+    luaM_flushfree(L);
+    pthread_mutex_lock(&q->lock);
+    q->stop = 1;
+    pthread_cond_signal(&q->wake);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);  /* worker drains the queue before exiting */
+    pthread_cond_destroy(&q->idle);
+    pthread_cond_destroy(&q->wake);
+    pthread_mutex_destroy(&q->lock);
+    g->freeq = NULL;
+    luaM_free(L, q);
+  }
+  return (q != NULL);
+}
+
+#else
+
+void luaM_flushfree (lua_State *L) { UNUSED(L); }
+
+void luaM_syncfree (lua_State *L) { UNUSED(L); }
+
+int luaM_setbgfree (lua_State *L, int on) {
+  UNUSED(L); UNUSED(on);
+  return -1;  /* not available */
+}
+
+#endif
+
+
+
 /*
 ** generic allocation routine.
 */
 void *luaM_realloc_ (lua_State *L, void *block, size_t osize, size_t nsize) {
   global_State *g = G(L);
+  void *nblock;
   lua_assert((osize == 0) == (block == NULL));
-  block = (*g->frealloc)(g->ud, block, osize, nsize);
+#if defined(LUA_USE_BGFREE)
+  if (nsize == 0 && g->deferfree && osize >= sizeof(FreeBlock)) {
+    deferfree(g->freeq, block, osize);
+    g->totalbytes -= osize;
+    return NULL;
+  }
+#endif
+  nblock = (*g->frealloc)(g->ud, block, osize, nsize);
+  if (nblock == NULL && nsize > 0 && g->freeq != NULL) {
+    luaM_syncfree(L);  /* give the worker's blocks back and retry */
+    nblock = (*g->frealloc)(g->ud, block, osize, nsize);
+  }
+  block = nblock;
   if (block == NULL && nsize > 0)
     luaD_throw(L, LUA_ERRMEM);
   lua_assert((nsize == 0) == (block == NULL));
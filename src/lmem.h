@@ -16,6 +16,9 @@
 #define MEMERRMSG	"not enough memory"
 
 
+typedef struct FreeQueue FreeQueue;
+
+
 #define luaM_reallocv(L,b,on,n,e) \
 	((cast(size_t, (n)+1) <= MAX_SIZET/(e)) ?  /* +1 to avoid warnings */ \
 		luaM_realloc_(L, (b), (on)*(e), (n)*(e)) : \
@@ -41,6 +44,9 @@
 LUAI_FUNC void *luaM_realloc_ (lua_State *L, void *block, size_t oldsize,
                                                           size_t size);
 LUAI_FUNC void *luaM_toobig (lua_State *L);
+LUAI_FUNC void luaM_flushfree (lua_State *L);
+LUAI_FUNC void luaM_syncfree (lua_State *L);
+LUAI_FUNC int luaM_setbgfree (lua_State *L, int on);
 LUAI_FUNC void *luaM_growaux_ (lua_State *L, void *block, int *size,
                                size_t size_elem, int limit,
                                const char *errormsg);
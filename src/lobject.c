@@ -80,6 +80,8 @@ int luaO_rawequalObj (const TValue *t1, const TValue *t2) {
       return bvalue(t1) == bvalue(t2);  /* boolean true must be 1 !! */
     case LUA_TLIGHTUSERDATA:
       return pvalue(t1) == pvalue(t2);
+    case LUA_TSTRING:
+      return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
     default:
       lua_assert(iscollectable(t1));
       return gcvalue(t1) == gcvalue(t2);
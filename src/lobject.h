@@ -204,11 +204,15 @@ typedef union TString {
   struct {
     CommonHeader;
     lu_byte reserved;
+    lu_byte lngstr;  /* long string: 1 = not hashed yet, 2 = hashed */
     unsigned int hash;
     size_t len;
   } tsv;
 } TString;
 
+/* long strings are not in the string table (see LUAI_MAXSHORTLEN) */
+#define islngstr(ts)	((ts)->tsv.lngstr != 0)
+
 
 #define getstr(ts)	cast(const char *, (ts) + 1)
 #define svalue(o)       getstr(rawtsvalue(o))
@@ -253,6 +257,10 @@ typedef struct Proto {
   lu_byte numparams;
   lu_byte is_vararg;
   lu_byte maxstacksize;
+  struct TableSite *tsites;  /* feedback for OP_NEWTABLE sites */
+  int sizetsites;
+  int *keyslots;  /* per pc: node where the constant string key was found */
+  int sizekeyslots;
   JIT_PROTO_STATE
 } Proto;
 
@@ -324,10 +332,14 @@ typedef union Closure {
 ** Tables
 */
 
+/*
+** `next' is an offset from the node, not a pointer: it fits in the padding
+** after `tt', so a Node takes 32 bytes (two per 64-byte cache line)
+*/
 typedef union TKey {
   struct {
     TValuefields;
-    struct Node *next;  /* for chaining */
+    int next;  /* for chaining (offset for next node, 0 ends the chain) */
   } nk;
   TValue tvk;
 } TKey;
@@ -349,9 +361,22 @@ typedef struct Table {
   Node *lastfree;  /* any free position is before this position */
   GCObject *gclist;
   int sizearray;  /* size of `array' array */
+  struct TableSite *site;  /* allocation site, while last created there */
 } Table;
 
 
+/*
+** Allocation-site feedback: entries used by the last table created by an
+** OP_NEWTABLE, used as the initial sizes of the next one
+*/
+typedef struct TableSite {
+  Table *last;  /* last table created at this site (weak) */
+  int pc;
+  int narray;  /* array border of the last table */
+  int nhash;  /* non-nil entries in the hash part of the last table */
+} TableSite;
+
+
 
 /*
 ** `module' operation for hashing (size is always a power of 2)
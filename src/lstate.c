@@ -6,6 +6,8 @@
 
 
 #include <stddef.h>
+#include <string.h>
+#include <time.h>
 
 #define lstate_c
 #define LUA_CORE
@@ -102,13 +104,37 @@ static void preinit_state (lua_State *L, global_State *g) {
 }
 
 
+#if defined(LUA_USE_RANDOMSEED)
+/*
+** mix the clock with some addresses (changed by ASLR) into the seed of
+** the string hash
+*/
+static unsigned int makeseed (lua_State *L) {
+  char buff[3 * sizeof(size_t)];
+  unsigned int h = luai_makeseed();
+  size_t t;
+  t = cast(size_t, L);  /* heap variable */
+  memcpy(buff, &t, sizeof(t));
+  t = cast(size_t, &h);  /* local variable */
+  memcpy(buff + sizeof(t), &t, sizeof(t));
+  t = cast(size_t, luaO_nilobject);  /* global variable */
+  memcpy(buff + 2*sizeof(t), &t, sizeof(t));
+  return luaS_hash(buff, sizeof(buff), h);
+}
+#else
+#define makeseed(L)	luai_makeseed()
+#endif
+
+
 static void close_state (lua_State *L) {
   global_State *g = G(L);
+  luaM_setbgfree(L, 0);  /* stop the free thread; free the rest inline */
   luaF_close(L, L->stack);  /* close all upvalues for this thread */
   luaC_freeall(L);  /* collect all objects */
   lua_assert(g->rootgc == obj2gco(L));
   lua_assert(g->strt.nuse == 0);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size, TString *);
+  luaM_freearray(L, G(L)->strt.oldhash, G(L)->strt.oldsize, TString *);
   luaZ_freebuffer(L, &g->buff);
   freestack(L, L);
   lua_assert(g->totalbytes == sizeof(LG));
@@ -167,6 +193,10 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->strt.size = 0;
   g->strt.nuse = 0;
   g->strt.hash = NULL;
+  g->strt.oldhash = NULL;
+  g->strt.oldsize = 0;
+  g->strt.rehashidx = 0;
+  g->seed = makeseed(L);
   setnilvalue(registry(L));
   luaZ_initbuffer(L, &g->buff);
   g->panic = NULL;
@@ -183,6 +213,18 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->memlimit = 0;
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
+  g->gcsteptime = 0;
+  g->gcpartial = NULL;
+  g->gcpartialidx = 0;
+  g->gckind = KGC_NORMAL;
+  g->gcminormul = LUAI_GCMINORMUL;
+  g->lastmajor = 0;
+  g->lastnusestr = 0;
+  g->freeq = NULL;
+  g->deferfree = 0;
+#if defined(LUA_USE_GCSTATS)
+  memset(&g->gcstats, 0, sizeof(GCStats));
+#endif
   g->gcdept = 0;
   JIT_NEW_STATE(L);
   for (i=0; i<NUM_TAGS; i++) g->mt[i] = NULL;
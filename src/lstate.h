@@ -42,6 +42,9 @@ typedef struct stringtable {
   GCObject **hash;
   lu_int32 nuse;  /* number of elements */
   int size;
+  GCObject **oldhash;  /* buckets not yet moved by an incremental resize */
+  int oldsize;  /* size of `oldhash' (0 when no resize is in progress) */
+  int rehashidx;  /* next bucket of `oldhash' to move */
 } stringtable;
 
 
@@ -67,17 +70,53 @@ typedef struct CallInfo {
 #define isLua(ci)	(ttisfunction((ci)->func) && f_isLua(ci))
 
 
+#if defined(LUA_USE_GCSTATS)
+
+/* kinds of collector work timed in `gcstats' */
+#define GCSTAT_PROPAGATE	0
+#define GCSTAT_ATOMIC		1
+#define GCSTAT_SWEEPSTRING	2  /* same value as GCSsweepstring */
+#define GCSTAT_SWEEP		3  /* same value as GCSsweep */
+#define GCSTAT_FINALIZE		4  /* same value as GCSfinalize */
+#define GCSTAT_STEP		5  /* whole luaC_step calls */
+#define GCSTAT_FULLGC		6  /* whole luaC_fullgc calls */
+#define GCSTAT_N		7
+
+/* bucket 0 counts times below 1us, bucket i times below 2^i us */
+#define GCSTAT_NBUCKETS		20
+
+typedef struct GCTimes {
+  unsigned long count;
+  double total;  /* in microseconds */
+  double max;
+  unsigned long hist[GCSTAT_NBUCKETS];
+} GCTimes;
+
+typedef struct GCStats {
+  GCTimes times[GCSTAT_N];
+  unsigned long nlimit;  /* collections forced by the memory limit */
+  unsigned long nallocfail;  /* full collections after a failed allocation */
+  int timing;  /* inside a timed luaC_step/luaC_fullgc */
+  int phase;  /* kind of the running phase slice */
+  double phasestart;
+  double callstart;
+} GCStats;
+
+#endif
+
+
 /*
 ** `global state', shared by all threads of this state
 */
 typedef struct global_State {
   stringtable strt;  /* hash table for strings */
+  unsigned int seed;  /* randomized seed for string hashes */
   lua_Alloc frealloc;  /* function to reallocate memory */
   void *ud;         /* auxiliary data to `frealloc' */
   lu_byte currentwhite;
   lu_byte gcstate;  /* state of garbage collector */
   lu_byte gcflags;  /* flags for the garbage collector */
-  int sweepstrgc;  /* position of sweep in `strt' */
+  int sweepstrgc;  /* position of sweep in `strt' (see `strtlist') */
   GCObject *rootgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* position of sweep in `rootgc' */
   GCObject *gray;  /* list of gray objects */
@@ -92,6 +131,18 @@ typedef struct global_State {
   lu_mem gcdept;  /* how much GC is `behind schedule' */
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC `granularity' */
+  int gcsteptime;  /* time budget of a step in microseconds (0: no limit) */
+  struct Table *gcpartial;  /* big table being traversed in chunks */
+  int gcpartialidx;  /* slots of `gcpartial' left to traverse */
+  lu_byte gckind;  /* kind of GC running (KGC_NORMAL or KGC_GEN) */
+  int gcminormul;  /* generational mode: heap growth (%) before a minor collection */
+  lu_mem lastmajor;  /* generational mode: heap size after the last major collection */
+  lu_int32 lastnusestr;  /* generational mode: strings left by the last string sweep */
+  FreeQueue *freeq;  /* background freeing of dead objects (NULL if off) */
+  lu_byte deferfree;  /* free blocks through `freeq' */
+#if defined(LUA_USE_GCSTATS)
+  GCStats gcstats;  /* collector timings (see collectgarbage("stats")) */
+#endif
   lua_CFunction panic;  /* to be called in unprotected errors */
   TValue l_registry;
   struct lua_State *mainthread;
@@ -12,6 +12,7 @@
 
 #include "lua.h"
 
+#include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -19,36 +20,148 @@
 
 
 
-void luaS_resize (lua_State *L, int newsize) {
-  stringtable *tb;
-  int i;
-  tb = &G(L)->strt;
-  if (G(L)->gcstate == GCSsweepstring || newsize == tb->size)
-    return;  /* cannot resize during GC traverse or doesn't need to be resized */
-  if (newsize > tb->size) {
-    luaM_reallocvector(L, tb->hash, tb->size, newsize, GCObject *);
-    for (i=tb->size; i<newsize; i++) tb->hash[i] = NULL;
+#if defined(LUA_USE_FULLHASH)
+
+/*
+** full-content hash: the string is read a machine word at a time and each
+** word is mixed in with a multiply and a shift (HASHMUL is 64 bits wide
+** where size_t is, the low half otherwise)
+*/
+#define HASHMUL		((cast(size_t, 0x9E3779B9u) << 16 << 16) | 0x7F4A7C15u)
+#define HASHSHIFT	(sizeof(size_t)*4 - 3)
+#define mixword(h,w)	{ h = ((h) ^ (w)) * HASHMUL; h ^= (h) >> HASHSHIFT; }
+
+unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
+  size_t h = seed ^ cast(size_t, l);
+  size_t w;
+  for (; l >= sizeof(size_t); l -= sizeof(size_t), str += sizeof(size_t)) {
+    memcpy(&w, str, sizeof(size_t));  /* unaligned load */
+    mixword(h, w);
   }
-  /* rehash */
-  for (i=0; i<tb->size; i++) {
-    GCObject *p = tb->hash[i];
-    tb->hash[i] = NULL;
+  w = 0;
+  memcpy(&w, str, l);  /* last bytes */
+  mixword(h, w);
+  h *= HASHMUL;
+  return cast(unsigned int, h ^ (h >> 16 >> 16) ^ (h >> HASHSHIFT));
+}
+
+#else
+
+unsigned int luaS_hash (const char *str, size_t l, unsigned int seed) {
+  unsigned int h = seed ^ cast(unsigned int, l);
+  size_t step = (l>>5)+1;  /* if string is too long, don't hash all its chars */
+  size_t l1;
+  for (l1=l; l1>=step; l1-=step)  /* compute hash */
+    h = h ^ ((h<<5)+(h>>2)+cast(unsigned char, str[l1-1]));
+  return h;
+}
+
+#endif
+
+
+/*
+** move up to `n' buckets of an unfinished resize into the new array; the
+** old array is freed once it is empty.  Nothing is moved while the strings
+** are swept, as `sweepstrgc' indexes both arrays.
+*/
+void luaS_rehash (lua_State *L, int n) {
+  stringtable *tb = &G(L)->strt;
+  if (tb->oldhash == NULL || G(L)->gcstate == GCSsweepstring)
+    return;
+  while (n-- > 0 && tb->rehashidx < tb->oldsize) {
+    GCObject *p = tb->oldhash[tb->rehashidx];
+    tb->oldhash[tb->rehashidx++] = NULL;
     while (p) {  /* for each node in the list */
       GCObject *next = p->gch.next;  /* save next */
       unsigned int h = gco2ts(p)->hash;
-      int h1 = lmod(h, newsize);  /* new position */
-      lua_assert(cast_int(h%newsize) == lmod(h, newsize));
+      int h1 = lmod(h, tb->size);  /* new position */
+      lua_assert(cast_int(h%tb->size) == lmod(h, tb->size));
       p->gch.next = tb->hash[h1];  /* chain it */
       tb->hash[h1] = p;
       p = next;
     }
   }
-  if (newsize < tb->size)
-    luaM_reallocvector(L, tb->hash, tb->size, newsize, GCObject *);
+  if (tb->rehashidx >= tb->oldsize) {  /* all buckets moved? */
+    GCObject **old = tb->oldhash;
+    int oldsize = tb->oldsize;
+    tb->oldhash = NULL;
+    tb->oldsize = 0;
+    tb->rehashidx = 0;
+    luaM_freearray(L, old, oldsize, GCObject *);
+    luaC_freedlive(G(L), oldsize * sizeof(GCObject *));
+  }
+}
+
+
+/*
+** start an incremental resize: new strings go to the new array and the
+** old buckets are moved a few at a time by `luaS_newlstr' and `luaC_step'
+*/
+void luaS_resize (lua_State *L, int newsize) {
+  stringtable *tb;
+  GCObject **newhash;
+  int i;
+  tb = &G(L)->strt;
+  if (G(L)->gcstate == GCSsweepstring || newsize == tb->size)
+    return;  /* cannot resize during GC traverse or doesn't need to be resized */
+  luaS_rehash(L, tb->oldsize);  /* finish a previous resize */
+  newhash = luaM_newvector(L, newsize, GCObject *);
+  if (tb->oldhash != NULL || G(L)->gcstate == GCSsweepstring) {
+    /* an emergency collection changed the table meanwhile */
+    luaM_freearray(L, newhash, newsize, GCObject *);
+    return;
+  }
+  for (i=0; i<newsize; i++) newhash[i] = NULL;
+  if (tb->size > 0) {
+    tb->oldhash = tb->hash;
+    tb->oldsize = tb->size;
+    tb->rehashidx = 0;
+  }
+  tb->hash = newhash;
   tb->size = newsize;
 }
 
 
+/*
+** long strings keep the seed in `hash' until they are first hashed
+*/
+unsigned int luaS_hashlngstr (TString *ts) {
+  lua_assert(islngstr(ts));
+  if (ts->tsv.lngstr == 1) {
+    ts->tsv.hash = luaS_hash(getstr(ts), ts->tsv.len, ts->tsv.hash);
+    ts->tsv.lngstr = 2;
+  }
+  return ts->tsv.hash;
+}
+
+
+int luaS_eqlngstr (TString *a, TString *b) {
+  size_t len = a->tsv.len;
+  return (a == b) ||  /* same instance or... */
+    (len == b->tsv.len && memcmp(getstr(a), getstr(b), len) == 0);
+}
+
+
+/*
+** long strings are not interned: they go in the `rootgc' list like any
+** other object and their hash is computed lazily by `luaS_hashlngstr'
+*/
+static TString *newlngstr (lua_State *L, const char *str, size_t l) {
+  TString *ts;
+  if (l+1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
+    luaM_toobig(L);
+  ts = cast(TString *, luaM_malloc(L, (l+1)*sizeof(char)+sizeof(TString)));
+  ts->tsv.len = l;
+  ts->tsv.hash = G(L)->seed;
+  ts->tsv.reserved = 0;
+  ts->tsv.lngstr = 1;
+  memcpy(ts+1, str, l*sizeof(char));
+  ((char *)(ts+1))[l] = '\0';  /* ending 0 */
+  luaC_link(L, obj2gco(ts), LUA_TSTRING);
+  return ts;
+}
+
+
 static TString *newlstr (lua_State *L, const char *str, size_t l,
                                        unsigned int h) {
   TString *ts;
@@ -56,7 +169,8 @@ static TString *newlstr (lua_State *L, const char *str, size_t l,
   if (l+1 > (MAX_SIZET - sizeof(TString))/sizeof(char))
     luaM_toobig(L);
   tb = &G(L)->strt;
-  if ((tb->nuse + 1) > cast(lu_int32, tb->size) && tb->size <= MAX_INT/2)
+  if ((tb->nuse + 1) > cast(lu_int32, tb->size) && tb->size <= MAX_INT/2 &&
+      tb->oldhash == NULL)
     luaS_resize(L, tb->size*2);  /* too crowded */
   ts = cast(TString *, luaM_malloc(L, (l+1)*sizeof(char)+sizeof(TString)));
   ts->tsv.len = l;
@@ -64,6 +178,7 @@ static TString *newlstr (lua_State *L, const char *str, size_t l,
   ts->tsv.marked = luaC_white(G(L));
   ts->tsv.tt = LUA_TSTRING;
   ts->tsv.reserved = 0;
+  ts->tsv.lngstr = 0;
   memcpy(ts+1, str, l*sizeof(char));
   ((char *)(ts+1))[l] = '\0';  /* ending 0 */
   h = lmod(h, tb->size);
@@ -75,13 +190,28 @@ static TString *newlstr (lua_State *L, const char *str, size_t l,
 
 
 TString *luaS_newlstr (lua_State *L, const char *str, size_t l) {
+  stringtable *tb = &G(L)->strt;
   GCObject *o;
-  unsigned int h = cast(unsigned int, l);  /* seed */
-  size_t step = (l>>5)+1;  /* if string is too long, don't hash all its chars */
-  size_t l1;
-  for (l1=l; l1>=step; l1-=step)  /* compute hash */
-    h = h ^ ((h<<5)+(h>>2)+cast(unsigned char, str[l1-1]));
-  for (o = G(L)->strt.hash[lmod(h, G(L)->strt.size)];
+  unsigned int h;
+  if (l > LUAI_MAXSHORTLEN)
+    return newlngstr(L, str, l);
+  h = luaS_hash(str, l, G(L)->seed);
+  if (tb->oldhash != NULL) {  /* resize in progress? */
+    luaS_rehash(L, STRTREHASHSTEP);
+    if (tb->oldhash != NULL) {
+      for (o = tb->oldhash[lmod(h, tb->oldsize)];
+           o != NULL;
+           o = o->gch.next) {
+        TString *ts = rawgco2ts(o);
+        if (ts->tsv.len == l && (memcmp(str, getstr(ts), l) == 0)) {
+          /* string may be dead */
+          if (isdead(G(L), o)) changewhite(o);
+          return ts;
+        }
+      }
+    }
+  }
+  for (o = tb->hash[lmod(h, tb->size)];
        o != NULL;
        o = o->gch.next) {
     TString *ts = rawgco2ts(o);
@@ -23,7 +23,27 @@
 
 #define luaS_fix(s)	l_setbit((s)->tsv.marked, FIXEDBIT)
 
+/*
+** while a resize is in progress strings live in two bucket arrays; the
+** sweeps walk both of them through a single index
+*/
+#define strtsize(tb)	((tb)->oldsize + (tb)->size)
+#define strtlist(tb,i)	((i) < (tb)->oldsize ? &(tb)->oldhash[i] : \
+                                 &(tb)->hash[(i) - (tb)->oldsize])
+
+/* equality of strings; only long strings may be equal with different
+   addresses */
+#define luaS_eqstr(a,b)	((a) == (b) || (islngstr(a) && luaS_eqlngstr(a, b)))
+
+/* hash of a string, computed on first use for long strings */
+#define luaS_strhash(ts)	((ts)->tsv.lngstr == 1 ? luaS_hashlngstr(ts) : \
+                                 (ts)->tsv.hash)
+
+LUAI_FUNC unsigned int luaS_hash (const char *str, size_t l, unsigned int seed);
+LUAI_FUNC unsigned int luaS_hashlngstr (TString *ts);
+LUAI_FUNC int luaS_eqlngstr (TString *a, TString *b);
 LUAI_FUNC void luaS_resize (lua_State *L, int newsize);
+LUAI_FUNC void luaS_rehash (lua_State *L, int n);
 LUAI_FUNC Udata *luaS_newudata (lua_State *L, size_t s, Table *e);
 LUAI_FUNC TString *luaS_newlstr (lua_State *L, const char *str, size_t l);
 
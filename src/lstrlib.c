@@ -18,6 +18,7 @@
 
 #include "lauxlib.h"
 #include "lualib.h"
+#include "lfastcall.h"
 
 
 /* macro to `unsign' a character */
@@ -25,6 +26,7 @@
 
 
 
+
 static int str_len (lua_State *L) {
   size_t l;
   luaL_checklstring(L, 1, &l);
@@ -822,23 +824,23 @@ static int str_format (lua_State *L) {
 }
 
 
-static const luaL_Reg strlib[] = {
-  {"byte", str_byte},
-  {"char", str_char},
-  {"dump", str_dump},
-  {"find", str_find},
-  {"format", str_format},
-  {"gfind", gfind_nodef},
-  {"gmatch", gmatch},
-  {"gsub", str_gsub},
-  {"len", str_len},
-  {"lower", str_lower},
-  {"match", str_match},
-  {"rep", str_rep},
-  {"reverse", str_reverse},
-  {"sub", str_sub},
-  {"upper", str_upper},
-  {NULL, NULL}
+static const luaL_Reg3 strlib[] = {
+  {"byte", str_byte, luaFC_strbyte},
+  {"char", str_char, luaFC_strchar},
+  {"dump", str_dump, NULL},
+  {"find", str_find, NULL},
+  {"format", str_format, NULL},
+  {"gfind", gfind_nodef, NULL},
+  {"gmatch", gmatch, NULL},
+  {"gsub", str_gsub, NULL},
+  {"len", str_len, luaFC_strlen},
+  {"lower", str_lower, NULL},
+  {"match", str_match, NULL},
+  {"rep", str_rep, NULL},
+  {"reverse", str_reverse, NULL},
+  {"sub", str_sub, luaFC_strsub},
+  {"upper", str_upper, NULL},
+  {NULL, NULL, NULL}
 };
 
 
@@ -858,7 +860,7 @@ static void createmetatable (lua_State *L) {
 ** Open string library
 */
 LUALIB_API int luaopen_string (lua_State *L) {
-  luaL_register(L, LUA_STRLIBNAME, strlib);
+  luaL_register3(L, LUA_STRLIBNAME, strlib);
 #if defined(LUA_COMPAT_GFIND)
   lua_getfield(L, -1, "gmatch");
   lua_setfield(L, -2, "gfind");
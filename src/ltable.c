@@ -32,6 +32,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
+#include "lstring.h"
 #include "ltable.h"
 
 
@@ -48,8 +49,12 @@
 
 
 #define hashpow2(t,n)      (gnode(t, lmod((n), sizenode(t))))
+
+/* chains link nodes by offsets (see TKey) */
+#define nextnode(n)	(gnext(n) != 0 ? (n) + gnext(n) : NULL)
+#define setnext(n,m)	(gnext(n) = ((m) != NULL ? cast_int((m) - (n)) : 0))
   
-#define hashstr(t,str)  hashpow2(t, (str)->tsv.hash)
+#define hashstr(t,str)  hashpow2(t, luaS_strhash(str))
 #define hashboolean(t,p)        hashpow2(t, p)
 
 
@@ -74,7 +79,7 @@
 
 static const Node dummynode_ = {
   {{NULL}, LUA_TNIL},  /* value */
-  {{{NULL}, LUA_TNIL, NULL}}  /* key */
+  {{{NULL}, LUA_TNIL, 0}}  /* key */
 };
 
 
@@ -134,7 +139,7 @@ static int arrayindex (const TValue *key) {
 ** elements in the array part, then elements in the hash part. The
 ** beginning of a traversal is signalled by -1.
 */
-static int findindex (lua_State *L, Table *t, StkId key) {
+int luaH_findindex (lua_State *L, Table *t, StkId key) {
   int i;
   if (ttisnil(key)) return -1;  /* first iteration */
   i = arrayindex(key);
@@ -151,7 +156,7 @@ static int findindex (lua_State *L, Table *t, StkId key) {
         /* hash elements are numbered after array ones */
         return i + t->sizearray;
       }
-      else n = gnext(n);
+      else n = nextnode(n);
     } while (n);
     luaG_runerror(L, "invalid key to " LUA_QL("next"));  /* key not found */
     return 0;  /* to avoid warnings */
@@ -160,7 +165,7 @@ static int findindex (lua_State *L, Table *t, StkId key) {
 
 
 int luaH_next (lua_State *L, Table *t, StkId key) {
-  int i = findindex(L, t, key);  /* find original element */
+  int i = luaH_findindex(L, t, key);  /* find original element */
   for (i++; i < t->sizearray; i++) {  /* try first array part */
     if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
       setnvalue(key, cast_num(i+1));
@@ -299,7 +304,7 @@ static void resizenodevector (lua_State *L, Table *t, int oldsize, int newsize)
     t->node = node;
     for (i=oldsize; i<newsize; i++) {
       Node *n = gnode(t, i);
-      gnext(n) = NULL;
+      gnext(n) = 0;
       setnilvalue(gkey(n));
       setnilvalue(gval(n));
     }
@@ -311,7 +316,7 @@ static void resizenodevector (lua_State *L, Table *t, int oldsize, int newsize)
 
 static Node *find_prev_node(Node *mp, Node *next) {
   Node *prev = mp;
-  while (prev != NULL && gnext(prev) != next) prev = gnext(prev);
+  while (prev != NULL && nextnode(prev) != next) prev = nextnode(prev);
   return prev;
 }
 
@@ -339,22 +344,29 @@ static int move_node (lua_State *L, Table *t, Node *node) {
       /* yes; swap colliding node with the node that is being moved. */
       Node *prev;
       Node tmp;
+      Node *nodenext = nextnode(node);
+      Node *mpnext = nextnode(mp);
       tmp = *node;
       prev = find_prev_node(othermp, mp);  /* find previous */
-      if (prev != NULL) gnext(prev) = node;  /* redo the chain with `n' in place of `mp' */
+      if (prev != NULL) setnext(prev, node);  /* redo the chain with `n' in place of `mp' */
       *node = *mp;  /* copy colliding node into free pos. (mp->next also goes) */
+      setnext(node, mpnext);
       *mp = tmp;
+      setnext(mp, nodenext);
       return (prev != NULL) ? 1 : 0; /* is colliding node part of its main position chain? */
     }
     else {  /* colliding node is in its own main position */
       /* add node to main position's chain. */
-      gnext(node) = gnext(mp);  /* chain new position */
-      gnext(mp) = node;
+      Node *mpnext = nextnode(mp);
+      setnext(node, mpnext);  /* chain new position */
+      setnext(mp, node);
     }
   }
   else { /* main position is free, move node */
+    Node *nodenext = nextnode(node);
     *mp = *node;
-    gnext(node) = NULL;
+    setnext(mp, nodenext);
+    gnext(node) = 0;
     setnilvalue(gkey(node));
     setnilvalue(gval(node));
   }
@@ -406,7 +418,7 @@ static void resize_hashpart (lua_State *L, Table *t, int nhsize) {
   /* break old chains, try moving int keys to array part and compact keys into new hashpart */
   for (i = 0; i < oldhsize; i++) {
     Node *old = gnode(t, i);
-    gnext(old) = NULL;
+    gnext(old) = 0;
     if (ttisnil(gval(old))) { /* clear nodes with nil values. */
       setnilvalue(gkey(old));
       continue;
@@ -436,6 +448,7 @@ static void resize_hashpart (lua_State *L, Table *t, int nhsize) {
 static void resize (lua_State *L, Table *t, int nasize, int nhsize) {
   int i;
   int oldasize = t->sizearray;
+  luaC_tableresize(L, t);
   if (nasize > oldasize)  /* array part must grow? */
     setarrayvector(L, t, nasize);
   resize_hashpart(L, t, nhsize);
@@ -458,6 +471,22 @@ void luaH_resizearray (lua_State *L, Table *t, int nasize) {
 }
 
 
+/*
+** store the `n' values from `v' at t[first .. first+n-1] (OP_SETLIST): the
+** array part is grown once, the values are copied in one block and a single
+** back barrier covers all of them
+*/
+void luaH_setlist (lua_State *L, Table *t, int first, const TValue *v, int n) {
+  int last = first + n - 1;
+  if (n <= 0) return;
+  if (last > t->sizearray)  /* needs more space? */
+    luaH_resizearray(L, t, last);  /* pre-alloc it at once */
+  memcpy(&t->array[first - 1], v, n * sizeof(TValue));
+  if (isblack(obj2gco(t)))
+    luaC_barrierback(L, t);
+}
+
+
 static void rehash (lua_State *L, Table *t, const TValue *ek) {
   int nasize, na;
   int nums[MAXBITS+1];  /* nums[i] = number of keys between 2^(i-1) and 2^i */
@@ -495,6 +524,7 @@ Table *luaH_new (lua_State *L, int narray, int nhash) {
   t->sizearray = 0;
   t->lsizenode = 0;
   t->node = cast(Node *, dummynode);
+  t->site = NULL;
   setarrayvector(L, t, narray);
   resizenodevector(L, t, 0, nhash);
   L->top--; /* remove table from stack */
@@ -502,7 +532,57 @@ Table *luaH_new (lua_State *L, int narray, int nhash) {
 }
 
 
+/*
+** max size hinted by an allocation site, a site only presizes tables that
+** are built up entry by entry, anything bigger pays for its own growth
+*/
+#define MAXSITESIZE	(1 << 10)
+
+
+/*
+** remember the entries `t' uses in its allocation site; tables are presized
+** from these, so only a table that really used its slots keeps the next
+** one big
+*/
+static void sitefeedback (Table *t) {
+  TableSite *site = t->site;
+  int na = t->sizearray;
+  int nh = 0;
+  int i;
+  while (na > 0 && ttisnil(&t->array[na - 1])) na--;  /* array border */
+  if (t->node != dummynode) {
+    for (i = sizenode(t) - 1; i >= 0; i--)
+      if (!ttisnil(gval(gnode(t, i)))) nh++;
+  }
+  site->narray = (na < MAXSITESIZE) ? na : MAXSITESIZE;
+  site->nhash = (nh < MAXSITESIZE) ? nh : MAXSITESIZE;
+  site->last = NULL;
+  t->site = NULL;
+}
+
+
+/*
+** create a table for allocation site `site', sized for what the previous
+** table from that site used
+*/
+Table *luaH_newsite (lua_State *L, TableSite *site, int narray, int nhash) {
+  Table *t;
+  if (site == NULL)
+    return luaH_new(L, narray, nhash);
+  if (site->last != NULL)
+    sitefeedback(site->last);
+  if (narray < site->narray) narray = site->narray;
+  if (nhash < site->nhash) nhash = site->nhash;
+  t = luaH_new(L, narray, nhash);
+  t->site = site;
+  site->last = t;
+  return t;
+}
+
+
 void luaH_free (lua_State *L, Table *t) {
+  if (t->site != NULL)
+    sitefeedback(t);
   if (t->node != dummynode)
     luaM_freearray(L, t->node, sizenode(t), Node);
   luaM_freearray(L, t->array, t->sizearray, TValue);
@@ -531,16 +611,22 @@ static TValue *newkey (lua_State *L, Table *t, const TValue *key) {
     othern = mainposition(t, key2tval(mp));
     if (othern != mp) {  /* is colliding node out of its main position? */
       /* yes; move colliding node into free position */
-      while (gnext(othern) != mp) othern = gnext(othern);  /* find previous */
-      gnext(othern) = n;  /* redo the chain with `n' in place of `mp' */
+      while (othern + gnext(othern) != mp)  /* find previous */
+        othern += gnext(othern);
+      setnext(othern, n);  /* redo the chain with `n' in place of `mp' */
+      luaC_tableresize(L, t);  /* `n' may be behind a partial traversal */
       *n = *mp;  /* copy colliding node into free pos. (mp->next also goes) */
-      gnext(mp) = NULL;  /* now `mp' is free */
+      if (gnext(mp) != 0) {
+        gnext(n) += cast_int(mp - n);  /* correct `next' */
+        gnext(mp) = 0;  /* now `mp' is free */
+      }
       setnilvalue(gval(mp));
     }
     else {  /* colliding node is in its own main position */
       /* new node will go into free position */
-      gnext(n) = gnext(mp);  /* chain new position */
-      gnext(mp) = n;
+      Node *mpnext = nextnode(mp);
+      setnext(n, mpnext);  /* chain new position */
+      setnext(mp, n);
       mp = n;
     }
   }
@@ -564,22 +650,59 @@ const TValue *luaH_getnum (Table *t, int key) {
     do {  /* check whether `key' is somewhere in the chain */
       if (ttisnumber(gkey(n)) && luai_numeq(nvalue(gkey(n)), nk))
         return gval(n);  /* that's it */
-      else n = gnext(n);
+      else n = nextnode(n);
     } while (n);
     return luaO_nilobject;
   }
 }
 
 
+/*
+** search function for long strings, which are compared by contents
+*/
+static const TValue *getlngstr (Table *t, TString *key) {
+  Node *n = hashpow2(t, luaS_hashlngstr(key));
+  do {  /* check whether `key' is somewhere in the chain */
+    if (ttisstring(gkey(n)) && luaS_eqlngstr(rawtsvalue(gkey(n)), key))
+      return gval(n);  /* that's it */
+    else n = nextnode(n);
+  } while (n);
+  return luaO_nilobject;
+}
+
+
 /*
 ** search function for strings
 */
 const TValue *luaH_getstr (Table *t, TString *key) {
-  Node *n = hashstr(t, key);
+  Node *n;
+  if (islngstr(key))
+    return getlngstr(t, key);
+  n = hashpow2(t, key->tsv.hash);
   do {  /* check whether `key' is somewhere in the chain */
     if (ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key)
       return gval(n);  /* that's it */
-    else n = gnext(n);
+    else n = nextnode(n);
+  } while (n);
+  return luaO_nilobject;
+}
+
+
+/*
+** search function for strings that also stores in `*slot' the index of
+** the node where `key' is found
+*/
+const TValue *luaH_getstrslot (Table *t, TString *key, int *slot) {
+  Node *n;
+  if (islngstr(key))
+    return getlngstr(t, key);
+  n = hashpow2(t, key->tsv.hash);
+  do {  /* check whether `key' is somewhere in the chain */
+    if (ttisstring(gkey(n)) && rawtsvalue(gkey(n)) == key) {
+      *slot = cast_int(n - t->node);
+      return gval(n);
+    }
+    else n = nextnode(n);
   } while (n);
   return luaO_nilobject;
 }
@@ -605,7 +728,7 @@ const TValue *luaH_get (Table *t, const TValue *key) {
       do {  /* check whether `key' is somewhere in the chain */
         if (luaO_rawequalObj(key2tval(n), key))
           return gval(n);  /* that's it */
-        else n = gnext(n);
+        else n = nextnode(n);
       } while (n);
       return luaO_nilobject;
     }
@@ -17,17 +17,28 @@
 
 #define key2tval(n)	(&(n)->i_key.tvk)
 
+/* node `i' of `t' has the string `key' (`i' may be out of range) */
+#define luaH_slotis(t,i,key) \
+	(cast(unsigned int, i) < cast(unsigned int, sizenode(t)) && \
+	 ttisstring(gkey(gnode(t, i))) && rawtsvalue(gkey(gnode(t, i))) == (key))
+
 
 LUAI_FUNC const TValue *luaH_getnum (Table *t, int key);
 LUAI_FUNC TValue *luaH_setnum (lua_State *L, Table *t, int key);
 LUAI_FUNC const TValue *luaH_getstr (Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getstrslot (Table *t, TString *key, int *slot);
 LUAI_FUNC TValue *luaH_setstr (lua_State *L, Table *t, TString *key);
 LUAI_FUNC const TValue *luaH_get (Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_set (lua_State *L, Table *t, const TValue *key);
 LUAI_FUNC Table *luaH_new (lua_State *L, int narray, int lnhash);
+LUAI_FUNC Table *luaH_newsite (lua_State *L, TableSite *site,
+                                int narray, int nhash);
 LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, int nasize);
+LUAI_FUNC void luaH_setlist (lua_State *L, Table *t, int first,
+                             const TValue *v, int n);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
+LUAI_FUNC int luaH_findindex (lua_State *L, Table *t, StkId key);
 LUAI_FUNC int luaH_getn (Table *t);
 
 
@@ -14,6 +14,7 @@
 
 #include "lauxlib.h"
 #include "lualib.h"
+#include "lfastcall.h"
 
 
 #define aux_getn(L,n)	(luaL_checktype(L, n, LUA_TTABLE), luaL_getn(L, n))
@@ -266,22 +267,22 @@ static int sort (lua_State *L) {
 /* }====================================================== */
 
 
-static const luaL_Reg tab_funcs[] = {
-  {"concat", tconcat},
-  {"foreach", foreach},
-  {"foreachi", foreachi},
-  {"getn", getn},
-  {"maxn", maxn},
-  {"insert", tinsert},
-  {"remove", tremove},
-  {"setn", setn},
-  {"sort", sort},
-  {NULL, NULL}
+static const luaL_Reg3 tab_funcs[] = {
+  {"concat", tconcat, NULL},
+  {"foreach", foreach, NULL},
+  {"foreachi", foreachi, NULL},
+  {"getn", getn, NULL},
+  {"maxn", maxn, NULL},
+  {"insert", tinsert, luaFC_tinsert},
+  {"remove", tremove, NULL},
+  {"setn", setn, NULL},
+  {"sort", sort, NULL},
+  {NULL, NULL, NULL}
 };
 
 
 LUALIB_API int luaopen_table (lua_State *L) {
-  luaL_register(L, LUA_TABLIBNAME, tab_funcs);
+  luaL_register3(L, LUA_TABLIBNAME, tab_funcs);
   return 1;
 }
 
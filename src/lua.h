@@ -231,8 +231,13 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCSETSTEPMUL	7
 #define LUA_GCSETMEMLIMIT	8
 #define LUA_GCGETMEMLIMIT	9
+#define LUA_GCGEN		10
+#define LUA_GCINC		11
+#define LUA_GCBGFREE		12
+#define LUA_GCSETSTEPTIME	13
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
+LUA_API int (lua_gcstats) (lua_State *L, int reset);
 
 
 /*
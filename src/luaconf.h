@@ -313,6 +313,91 @@
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
 
 
+/*
+@@ LUAI_GCMINORMUL defines how much the heap grows (as a percentage of its
+@* size after the last collection) between minor collections in generational
+@* mode.  Major collections use LUAI_GCPAUSE relative to the heap size after
+@* the last major collection.
+** CHANGE it if you want minor collections to run more or less often.  You
+** can also change this value dynamically.
+*/
+#define LUAI_GCMINORMUL	20  /* minor collection when the heap grows by 20% */
+
+
+/*
+@@ LUA_USE_BGFREE allows dead objects to be freed by a background thread
+@* (turned on with lua_gc(L, LUA_GCBGFREE, 1)).
+** CHANGE it (define it) if you have POSIX threads (needs -lpthread).  The
+** allocator function must then be able to free blocks from another thread.
+*/
+/* #define LUA_USE_BGFREE */
+
+
+/*
+@@ LUA_USE_GCSTATS keeps timing histograms of the collector phases and
+@* counts of emergency collections (see collectgarbage("stats")).
+** CHANGE it (define it) if you want to tune the collector from data.
+*/
+/* #define LUA_USE_GCSTATS */
+
+
+/*
+@@ luai_gcclock sets its argument to a time stamp in microseconds; it is
+@* used by time-bounded collector steps and by LUA_USE_GCSTATS (the user
+@* must include <time.h>).
+** CHANGE it if you have a better clock.
+*/
+#if defined(LUA_USE_POSIX)
+#define luai_gcclock(t)	{ struct timespec ts_; \
+	clock_gettime(CLOCK_MONOTONIC, &ts_); \
+	(t) = (double)ts_.tv_sec*1e6 + (double)ts_.tv_nsec/1e3; }
+#else
+#define luai_gcclock(t)	((t) = (double)clock()*1e6/CLOCKS_PER_SEC)
+#endif
+
+
+/*
+@@ LUA_USE_POOLALLOC makes luaL_newstate use the size-class pool allocator
+@* of luaL_newpoolstate instead of plain realloc/free.
+** CHANGE it (define it) if your programs allocate many small objects.
+** Pool pages are only released when the state is closed, so the memory
+** limit (collectgarbage("setmemlimit")) bounds the bytes in use but not
+** the memory taken from the system, which stays at its peak.
+*/
+/* #define LUA_USE_POOLALLOC */
+
+
+/*
+@@ LUA_USE_FULLHASH makes the string hash read every byte of a string, a
+@* machine word at a time.  By default strings longer than 32 bytes are
+@* hashed from a sample of their bytes, so long strings that differ only
+@* in the skipped bytes all fall in the same bucket.
+** CHANGE it (define it) if your programs intern many long strings that
+** share most of their contents (URLs, serialized data, untrusted input).
+*/
+/* #define LUA_USE_FULLHASH */
+
+
+/*
+@@ LUA_USE_RANDOMSEED gives each new state a random seed for the string
+@* hash, mixed from the clock and some addresses (changed by ASLR), so
+@* the colliding strings of one run are not known in advance.  By default
+@* the seed is constant and hash values and table orders are the same on
+@* every run.
+** CHANGE it (define it) if your programs hash untrusted input, together
+** with LUA_USE_FULLHASH.
+@@ luai_makeseed returns the seed (the user must include <time.h>).
+** CHANGE it if you have a better source of randomness.
+*/
+/* #define LUA_USE_RANDOMSEED */
+
+#if defined(LUA_USE_RANDOMSEED)
+#define luai_makeseed()	cast(unsigned int, time(NULL))
+#else
+#define luai_makeseed()	0
+#endif
+
+
 
 /*
 @@ LUA_COMPAT_GETN controls compatibility with old getn behavior.
@@ -486,6 +571,14 @@
 #define LUAI_MAXUPVALUES	60
 
 
+/*
+@@ LUAI_MAXSHORTLEN is the maximum length of strings kept in the string
+@* table.  Longer strings are not interned: they are hashed only when used
+@* as table keys and compared by contents.
+*/
+#define LUAI_MAXSHORTLEN	40
+
+
 /*
 @@ LUAL_BUFFERSIZE is the buffer size used by the lauxlib buffer system.
 */
@@ -170,6 +170,59 @@ void luaV_settable (lua_State *L, const TValue *t, TValue *key, StkId val) {
 }
 
 
+/*
+** luaV_gettable/luaV_settable for constant string keys.  `slot' caches
+** the node where the key was found last time: tables built the same way
+** (same sizes, keys inserted in the same order) have the key in the same
+** node, so the lookup of a field of an object-like table, or of a method
+** in its class, is a single key compare.
+*/
+void luaV_getstr (lua_State *L, const TValue *t, TValue *key, StkId val,
+                  int *slot) {
+  TString *ts = rawtsvalue(key);
+  int loop;
+  for (loop = 0; loop < MAXTAGLOOP; loop++) {
+    const TValue *tm;
+    if (ttistable(t)) {  /* `t' is a table? */
+      Table *h = hvalue(t);
+      const TValue *res = luaH_slotis(h, *slot, ts) ? gval(gnode(h, *slot)) :
+                                                  luaH_getstrslot(h, ts, slot);
+      if (!ttisnil(res) ||  /* result is no nil? */
+          (tm = fasttm(L, h->metatable, TM_INDEX)) == NULL) { /* or no TM? */
+        setobj2s(L, val, res);
+        return;
+      }
+      /* else will try the tag method */
+    }
+    else if (ttisnil(tm = luaT_gettmbyobj(L, t, TM_INDEX)))
+      luaG_typeerror(L, t, "index");
+    if (ttisfunction(tm)) {
+      callTMres(L, val, tm, t, key);
+      return;
+    }
+    t = tm;  /* else repeat with `tm' */
+  }
+  luaG_runerror(L, "loop in gettable");
+}
+
+
+void luaV_setstr (lua_State *L, const TValue *t, TValue *key, StkId val,
+                  int *slot) {
+  if (ttistable(t)) {
+    Table *h = hvalue(t);
+    TString *ts = rawtsvalue(key);
+    const TValue *oldval = luaH_slotis(h, *slot, ts) ?
+                           gval(gnode(h, *slot)) : luaH_getstrslot(h, ts, slot);
+    if (!ttisnil(oldval)) {  /* existing field: no tag method, no rehash */
+      setobj2t(L, cast(TValue *, oldval), val);
+      luaC_barriert(L, h, val);
+      return;
+    }
+  }
+  luaV_settable(L, t, key, val);
+}
+
+
 int luaV_call_binTM (lua_State *L, const TValue *p1, const TValue *p2,
                        StkId res, TMS event) {
   const TValue *tm = luaT_gettmbyobj(L, p1, event);  /* try first operand */
@@ -268,6 +321,7 @@ int luaV_equalval (lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_TNUMBER: return luai_numeq(nvalue(t1), nvalue(t2));
     case LUA_TBOOLEAN: return bvalue(t1) == bvalue(t2);  /* true must be 1 !! */
     case LUA_TLIGHTUSERDATA: return pvalue(t1) == pvalue(t2);
+    case LUA_TSTRING: return luaS_eqstr(rawtsvalue(t1), rawtsvalue(t2));
     case LUA_TUSERDATA: {
       if (uvalue(t1) == uvalue(t2)) return 1;
       tm = get_compTM(L, uvalue(t1)->metatable, uvalue(t2)->metatable,
@@ -460,7 +514,13 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         continue;
       }
       case OP_GETTABLE: {
-        Protect(luaV_gettable(L, RB(i), RKC(i), ra));
+        TValue *rc = RKC(i);
+        if (ISK(GETARG_C(i)) && ttisstring(rc)) {
+          Protect(luaV_getstr(L, RB(i), rc, ra,
+                              luaF_keyslot(L, cl->p, pcRel(pc, cl->p))));
+        }
+        else
+          Protect(luaV_gettable(L, RB(i), rc, ra));
         continue;
       }
       case OP_SETGLOBAL: {
@@ -477,22 +537,35 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         continue;
       }
       case OP_SETTABLE: {
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
+        TValue *rb = RKB(i);
+        if (ISK(GETARG_B(i)) && ttisstring(rb)) {
+          Protect(luaV_setstr(L, ra, rb, RKC(i),
+                              luaF_keyslot(L, cl->p, pcRel(pc, cl->p))));
+        }
+        else
+          Protect(luaV_settable(L, ra, rb, RKC(i)));
         continue;
       }
       case OP_NEWTABLE: {
         int b = GETARG_B(i);
         int c = GETARG_C(i);
         Table *h;
-        Protect(h = luaH_new(L, luaO_fb2int(b), luaO_fb2int(c)));
+        Protect(h = luaH_newsite(L, luaF_tablesite(L, cl->p, pcRel(pc, cl->p)),
+                                 luaO_fb2int(b), luaO_fb2int(c)));
         sethvalue(L, RA(i), h);
         Protect(luaC_checkGC(L));
         continue;
       }
       case OP_SELF: {
         StkId rb = RB(i);
+        TValue *rc = RKC(i);
         setobjs2s(L, ra+1, rb);
-        Protect(luaV_gettable(L, rb, RKC(i), ra));
+        if (ISK(GETARG_C(i)) && ttisstring(rc)) {
+          Protect(luaV_getstr(L, rb, rc, ra,
+                              luaF_keyslot(L, cl->p, pcRel(pc, cl->p))));
+        }
+        else
+          Protect(luaV_gettable(L, rb, rc, ra));
         continue;
       }
       case OP_ADD: {
@@ -722,8 +795,6 @@ void luaV_execute (lua_State *L, int nexeccalls) {
       case OP_SETLIST: {
         int n = GETARG_B(i);
         int c = GETARG_C(i);
-        int last;
-        Table *h;
         fixedstack(L);
         if (n == 0) {
           n = cast_int(L->top - ra) - 1;
@@ -731,15 +802,7 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         }
         if (c == 0) c = cast_int(*pc++);
         runtime_check(L, ttistable(ra));
-        h = hvalue(ra);
-        last = ((c-1)*LFIELDS_PER_FLUSH) + n;
-        if (last > h->sizearray)  /* needs more space? */
-          luaH_resizearray(L, h, last);  /* pre-alloc it at once */
-        for (; n > 0; n--) {
-          TValue *val = ra+n;
-          setobj2t(L, luaH_setnum(L, h, last--), val);
-          luaC_barriert(L, h, val);
-        }
+        luaH_setlist(L, hvalue(ra), (c-1)*LFIELDS_PER_FLUSH + 1, ra+1, n);
         unfixedstack(L);
         continue;
       }
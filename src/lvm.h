@@ -34,6 +34,10 @@ LUAI_FUNC void luaV_gettable (lua_State *L, const TValue *t, TValue *key,
                                             StkId val);
 LUAI_FUNC void luaV_settable (lua_State *L, const TValue *t, TValue *key,
                                             StkId val);
+LUAI_FUNC void luaV_getstr (lua_State *L, const TValue *t, TValue *key,
+                                          StkId val, int *slot);
+LUAI_FUNC void luaV_setstr (lua_State *L, const TValue *t, TValue *key,
+                                          StkId val, int *slot);
 LUAI_FUNC void luaV_arith (lua_State *L, StkId ra, const TValue *rb,
                                          const TValue *rc, TMS op);
 LUAI_FUNC void luaV_execute (lua_State *L, int nexeccalls);